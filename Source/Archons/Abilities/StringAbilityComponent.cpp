@@ -2,14 +2,29 @@
 
 #include "StringAbilityComponent.h"
 
+#include "Archons/Archons.h"
+#include "Archons/Game/HitchWatchdogSubsystem.h"
 #include "Archons/Interfaces/SpanAbilityOwner.h"
+#include "Components/CapsuleComponent.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 
+DECLARE_CYCLE_STAT(TEXT("String Ability String Damage"), STAT_StringAbilityStringDamage, STATGROUP_Archons);
+DECLARE_CYCLE_STAT(TEXT("String Ability Simulation"), STAT_StringAbilitySimulation, STATGROUP_Archons);
+
 UStringAbilityComponent::UStringAbilityComponent()
 {
     PrimaryComponentTick.bCanEverTick = true;
 
+    // Reads the span once both characters have moved and damages enemies once they have moved too
+    PrimaryComponentTick.TickGroup = TG_PostPhysics;
+
+    // Only touches the solver and its input, nothing else of the component or the world
+    SolverTickFunction.bCanEverTick = true;
+    SolverTickFunction.bStartWithTickEnabled = false;
+    SolverTickFunction.bRunOnAnyThread = true;
+    SolverTickFunction.TickGroup = TG_PrePhysics;
+
     bDebug = false;
     bIsAbilityActive = false;
 
@@ -20,8 +35,29 @@ UStringAbilityComponent::UStringAbilityComponent()
     Damage = 10.0f;
     DamageRadius = 75.0f;
 
+    MaxTargetSpeed = 1200.0f;
+
+    DamageMode = EStringDamageMode::Peaks;
+    StringCollisionSegments = 64;
+    StringThickness = 10.0f;
+    StringHitCooldown = 1.0f;
+    StringBroadphaseHalfHeight = 200.0f;
+
+    ShapeMode = EStringShapeMode::StandingWave;
+    SimulationNodes = 256;
+    SimulationTimeStep = 1.0f / 480.0f;
+    SimulationDamping = 0.2f;
+    SimulationPeakThreshold = 0.25f;
+
     ActivationTime = 0.0;
-    bShouldDealDamage = false;
+    PreviousElapsedTime = 0.0;
+    PreviousPointA = FVector::ZeroVector;
+    PreviousPointB = FVector::ZeroVector;
+    bHasPreviousSample = false;
+
+    PeakKernel = nullptr;
+
+    bPendingSolverReset = false;
 }
 
 void UStringAbilityComponent::BeginPlay()
@@ -30,7 +66,42 @@ void UStringAbilityComponent::BeginPlay()
 
     AbilityOwnerRef = Cast<ISpanAbilityOwner>(GetOwner());
     ensureAlwaysMsgf(AbilityOwnerRef.IsValid(), TEXT("Owning actor should implement %s interface"), *USpanAbilityOwner::StaticClass()->GetName());
+
+    StringSolver.Initialize(SimulationNodes, SimulationTimeStep);
+    SimulatedPeaks.Reserve(SimulationNodes);
+
+    UpdatePeakKernel();
+}
+
+void UStringAbilityComponent::RegisterComponentTickFunctions(bool bRegister)
+{
+    Super::RegisterComponentTickFunctions(bRegister);
+
+    if (bRegister)
+    {
+        if (SetupActorComponentTickFunction(&SolverTickFunction))
+        {
+            SolverTickFunction.Target = this;
+            PrimaryComponentTick.AddPrerequisite(this, SolverTickFunction);
+        }
+    }
+    else if (SolverTickFunction.IsTickFunctionRegistered())
+    {
+        SolverTickFunction.UnRegisterTickFunction();
+    }
+}
+
+#if WITH_EDITOR
+void UStringAbilityComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+    Super::PostEditChangeProperty(PropertyChangedEvent);
+
+    if (PropertyChangedEvent.GetMemberPropertyName() == GET_MEMBER_NAME_CHECKED(UStringAbilityComponent, Harmonic))
+    {
+        UpdatePeakKernel();
+    }
 }
+#endif
 
 void UStringAbilityComponent::ActivateAbility()
 {
@@ -38,6 +109,12 @@ void UStringAbilityComponent::ActivateAbility()
 
     bIsAbilityActive = true;
     ActivationTime = GetWorld()->TimeSeconds;
+    bHasPreviousSample = false;
+    PreviousTargetLocations.Reset();
+
+    bPendingSolverReset = true;
+    PendingPlucks.Reset();
+    PluckString();
 }
 
 void UStringAbilityComponent::DeactivateAbility()
@@ -47,14 +124,51 @@ void UStringAbilityComponent::DeactivateAbility()
     bIsAbilityActive = false;
 }
 
+void UStringAbilityComponent::RestoreState(const double InPeriod, const float InAmplitude, const int32 InHarmonic, const float InDamageRadius, const bool bInIsAbilityActive, const double ElapsedTime)
+{
+    Period = FMath::Clamp(InPeriod, 1.0, 5.0);
+    Amplitude = FMath::Clamp(InAmplitude, 75.0f, 200.0f);
+    Harmonic = FMath::Clamp(InHarmonic, 2, 5);
+    DamageRadius = FMath::Clamp(InDamageRadius, 75.0f, 150.0f);
+    UpdatePeakKernel();
+
+    bIsAbilityActive = bInIsAbilityActive;
+    ActivationTime = GetWorld()->TimeSeconds - ElapsedTime;
+    bHasPreviousSample = false;
+    PreviousTargetLocations.Reset();
+
+    // The simulated string is not part of the snapshot, it starts ringing again from a fresh pluck
+    bPendingSolverReset = true;
+    PendingPlucks.Reset();
+    PluckString();
+}
+
 void UStringAbilityComponent::UpgradeAbility()
 {
     Harmonic = FMath::Clamp(Harmonic + 1, 2, 5);
+    UpdatePeakKernel();
+    PluckString();
 }
 
 void UStringAbilityComponent::DegradeAbility()
 {
     Harmonic = FMath::Clamp(Harmonic - 1, 2, 5);
+    UpdatePeakKernel();
+    PluckString();
+}
+
+void UStringAbilityComponent::PluckString()
+{
+    if (ShapeMode != EStringShapeMode::Simulated) { return; }
+
+    // Excites the current harmonic on top of whatever is still ringing, once the solver tick picks it up
+    PendingPlucks.Add(Harmonic);
+}
+
+void UStringAbilityComponent::UpdatePeakKernel()
+{
+    PeakKernel = StringPeakKernels::GetKernel(Harmonic);
+    ensureMsgf(PeakKernel, TEXT("No peak kernel for harmonic %i"), Harmonic);
 }
 
 void UStringAbilityComponent::EnlargeAbility()
@@ -91,7 +205,11 @@ void UStringAbilityComponent::TickComponent(float DeltaTime, ELevelTick TickType
 {
     Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-    if (!bDebug || !bIsAbilityActive || !AbilityOwnerRef.IsValid()) { return; }
+    FHitchWatchdogScope HitchScope(EHitchWatchdogTimer::StringAbility);
+
+    UpdateSolverInput();
+
+    if (!IsStringEvaluated()) { return; }
 
     FVector PointA, PointB;
     if (!AbilityOwnerRef->GetAbilitySpan(PointA, PointB)) { return; }
@@ -100,101 +218,408 @@ void UStringAbilityComponent::TickComponent(float DeltaTime, ELevelTick TickType
     const double ElapsedTime = GetWorld()->TimeSeconds - ActivationTime;
     const double CycleTime = FMath::Wrap(ElapsedTime, 0.0, Period);
     const double NormalizedCycleTime = CycleTime / Period;
+    UHitchWatchdogSubsystem::SetAbilityPhase(static_cast<float>(NormalizedCycleTime));
 
     const FVector StringNormal = FVector::CrossProduct(PointB - PointA, FVector::ZAxisVector).GetSafeNormal();
 
-    constexpr int32 NumSegments = 20;
-    constexpr double SegmentDelta = 1.0 / static_cast<double>(NumSegments - 1);
+    // The string damage mode collides with the same points that are drawn, so it needs a finer polyline
+    const bool bStringDamage = DamageMode != EStringDamageMode::Peaks;
+    const int32 NumSegments = bStringDamage ? StringCollisionSegments + 1 : 20;
+    const double SegmentDelta = 1.0 / static_cast<double>(NumSegments - 1);
 
     // Modulate the wave amplitude based on the position in the cycle
     const double AmplitudeModulator = FMath::Cos(NormalizedCycleTime * UE_DOUBLE_TWO_PI);
-    DrawStringSegments(PointA, PointB, StringNormal, NumSegments, SegmentDelta, AmplitudeModulator);
+    EvaluateStringSegments(PointA, PointB, StringNormal, NumSegments, SegmentDelta, AmplitudeModulator);
+    DrawStringSegments();
+
+    if (!bHasPreviousSample)
+    {
+        PreviousElapsedTime = ElapsedTime;
+        PreviousPointA = PointA;
+        PreviousPointB = PointB;
+        PreviousStringPoints = StringPoints;
+        bHasPreviousSample = true;
+    }
+
+    if (DamageMode != EStringDamageMode::String)
+    {
+        HandleDamageCycle(ElapsedTime, NormalizedCycleTime, PointA, PointB, StringNormal);
+        RecordTargetLocations(ElapsedTime, PointA, PointB);
+    }
+
+    if (bStringDamage)
+    {
+        DealDamageAlongString(PointA, PointB);
+    }
+
+    PreviousElapsedTime = ElapsedTime;
+    PreviousPointA = PointA;
+    PreviousPointB = PointB;
+    PreviousStringPoints = StringPoints;
+}
+
+void FStringSolverTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+    if (IsValid(Target))
+    {
+        Target->TickSolver(DeltaTime);
+    }
+}
+
+FString FStringSolverTickFunction::DiagnosticMessage()
+{
+    return Target ? Target->GetFullName() + TEXT("[TickSolver]") : TEXT("<NULL>[TickSolver]");
+}
+
+bool UStringAbilityComponent::IsStringEvaluated() const
+{
+    return bDebug && bIsAbilityActive && AbilityOwnerRef.IsValid();
+}
+
+void UStringAbilityComponent::UpdateSolverInput()
+{
+    // Nothing reads the solver unless the simulated string is evaluated, so its tick is only scheduled then.
+    // Whenever it starts again, the string rings from a fresh pluck like after a restore.
+    const bool bSimulate = IsStringEvaluated() && ShapeMode == EStringShapeMode::Simulated;
+    if (bSimulate != SolverTickFunction.IsTickFunctionEnabled())
+    {
+        SolverTickFunction.SetTickFunctionEnable(bSimulate);
+        bPendingSolverReset = true;
+        PendingPlucks.Reset();
+        PendingPlucks.Add(Harmonic);
+        SimulatedPeaks.Reset();
+        SimulatedCrests.Reset();
+    }
+
+    // The solver tick of this frame is done, so its input can be written until the next one starts
+    SolverInput.bSimulate = bSimulate;
+    if (!bSimulate) { return; }
+
+    if (bPendingSolverReset)
+    {
+        SolverInput.bReset = true;
+        SolverInput.Plucks.Reset();
+        bPendingSolverReset = false;
+    }
+
+    SolverInput.Plucks.Append(PendingPlucks);
+    PendingPlucks.Reset();
+
+    // The current harmonic completes one oscillation per period, other harmonics ring at their own frequencies
+    SolverInput.WaveSpeed = 2.0f / (static_cast<float>(Harmonic) * static_cast<float>(Period));
+    SolverInput.Damping = SimulationDamping;
+    SolverInput.PeakThreshold = SimulationPeakThreshold;
+}
+
+void UStringAbilityComponent::TickSolver(const float DeltaTime)
+{
+    SCOPE_CYCLE_COUNTER(STAT_StringAbilitySimulation);
+
+    if (!SolverInput.bSimulate)
+    {
+        SimulatedCrests.Reset();
+        return;
+    }
+
+    if (SolverInput.bReset)
+    {
+        StringSolver.Reset();
+        SolverInput.bReset = false;
+    }
+
+    for (const int32 PluckHarmonic : SolverInput.Plucks)
+    {
+        StringSolver.Pluck(PluckHarmonic, 1.0f);
+    }
+    SolverInput.Plucks.Reset();
+
+    StringSolver.SetWaveSpeed(SolverInput.WaveSpeed);
+    StringSolver.SetDamping(SolverInput.Damping);
+    StringSolver.SetCrestThreshold(SolverInput.PeakThreshold);
+    StringSolver.Advance(DeltaTime);
+
+    SimulatedCrests.Reset();
+    SimulatedCrests.Append(StringSolver.GetCrests());
 
-    HandleDamageCycle(NormalizedCycleTime, PointA, PointB, StringNormal);
+    // Extrema below the threshold are ripples, not peaks
+    StringSolver.FindPeaks(SolverInput.PeakThreshold, SimulatedPeaks);
 }
 
-void UStringAbilityComponent::DrawStringSegments(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, int32 NumSegments, double SegmentDelta, double AmplitudeModulator) const
+void UStringAbilityComponent::EvaluateStringSegments(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, int32 NumSegments, double SegmentDelta, double AmplitudeModulator)
 {
+    StringPoints.Reset(NumSegments);
+
     for (int32 Segment = 0; Segment < NumSegments; ++Segment)
     {
         const double OffsetNorm = SegmentDelta * static_cast<double>(Segment);
         const FVector SegmentPosition = UKismetMathLibrary::VLerp(PointA, PointB, OffsetNorm);
-        const double WaveValue = FMath::Sin(OffsetNorm * UE_DOUBLE_PI * static_cast<double>(Harmonic)) * Amplitude * AmplitudeModulator;
+        const double WaveValue = ShapeMode == EStringShapeMode::Simulated
+            ? static_cast<double>(StringSolver.Sample(static_cast<float>(OffsetNorm))) * Amplitude
+            : FMath::Sin(OffsetNorm * UE_DOUBLE_PI * static_cast<double>(Harmonic)) * Amplitude * AmplitudeModulator;
+
+        StringPoints.Add(SegmentPosition + StringNormal * WaveValue);
+    }
+}
 
-        DrawDebugPoint(GetWorld(), SegmentPosition + StringNormal * WaveValue, 4, FColor::Blue);
+void UStringAbilityComponent::DrawStringSegments() const
+{
+    for (const FVector& StringPoint : StringPoints)
+    {
+        DrawDebugPoint(GetWorld(), StringPoint, 4, FColor::Blue);
     }
 }
 
 // Handle displaying telegraphs and dealing damage based on the current cycle time
-void UStringAbilityComponent::HandleDamageCycle(const double NormalizedCycleTime, const FVector& PointA, const FVector& PointB, const FVector& StringNormal)
+void UStringAbilityComponent::HandleDamageCycle(const double ElapsedTime, const double NormalizedCycleTime, const FVector& PointA, const FVector& PointB, const FVector& StringNormal)
 {
-    // The cycle starts and ends on the same peak value, that's why there are 2 values for the range comparisons to work properly
-    constexpr double PeakTime1_0 = 0.0;
+    using namespace StringPeakDamage;
+
     constexpr double ZeroAmplitudeTime1 = 0.25;
-    constexpr double PeakTime2 = 0.5;
     constexpr double ZeroAmplitudeTime2 = 0.75;
-    constexpr double PeakTime1_1 = 1.0;
 
     // Display telegraph effects
     if (FMath::IsWithinInclusive(NormalizedCycleTime, ZeroAmplitudeTime1, PeakTime2))
     {
-        bShouldDealDamage = true;
         const double TelegraphRadius = FMath::Lerp(0.0, DamageRadius, (NormalizedCycleTime - ZeroAmplitudeTime1) * 4.0);
         DisplayDamageTelegraphs(PointA, PointB, StringNormal, TelegraphRadius, PeakTime2);
     }
-    else if (FMath::IsWithinInclusive(NormalizedCycleTime, ZeroAmplitudeTime2, PeakTime1_1))
+    else if (FMath::IsWithinInclusive(NormalizedCycleTime, ZeroAmplitudeTime2, PeakTime1))
     {
-        bShouldDealDamage = true;
         const double TelegraphRadius = FMath::Lerp(0.0, DamageRadius, (NormalizedCycleTime - ZeroAmplitudeTime2) * 4.0);
-        DisplayDamageTelegraphs(PointA, PointB, StringNormal, TelegraphRadius, PeakTime1_1);
+        DisplayDamageTelegraphs(PointA, PointB, StringNormal, TelegraphRadius, PeakTime1);
     }
-    // Apply radial damage at each peak after the telegraph phase ends
-    else if (bShouldDealDamage && FMath::IsWithinInclusive(NormalizedCycleTime, PeakTime1_0, ZeroAmplitudeTime1))
+
+    // The simulated string has no schedule, it deals damage whenever its own peaks crest
+    if (ShapeMode == EStringShapeMode::Simulated)
     {
-        bShouldDealDamage = false;
-        DealDamageAtPeaks(PointA, PointB, StringNormal, PeakTime1_0);
+        DealDamageAtCrests(ElapsedTime, PointA, PointB);
+        return;
     }
-    else if (bShouldDealDamage && FMath::IsWithinInclusive(NormalizedCycleTime, PeakTime2, ZeroAmplitudeTime2))
+
+    // Every peak passed since the previous tick is evaluated at its exact time, see StringPeakDamage
+    FPeakEvents PeakEvents;
+    FindPeakEvents(Period, {PreviousElapsedTime, PreviousPointA, PreviousPointB}, {ElapsedTime, PointA, PointB}, PeakEvents);
+
+    TArray<FVector, TInlineAllocator<8>> PeakPositions;
+    for (const FPeakEvent& PeakEvent : PeakEvents)
     {
-        bShouldDealDamage = false;
-        DealDamageAtPeaks(PointA, PointB, StringNormal, PeakTime2);
+        UHitchWatchdogSubsystem::Count(EHitchWatchdogCounter::PeaksFired);
+        GetPeakPositions(PeakEvent.PointA, PeakEvent.PointB, PeakEvent.StringNormal, PeakEvent.PeakTime, PeakPositions);
+        DealDamageAtPeaks(PeakEvent, PeakPositions, ElapsedTime);
     }
 }
 
-void UStringAbilityComponent::DisplayDamageTelegraphs(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double TelegraphRadius, const double PeakTime) const
+void UStringAbilityComponent::DealDamageAtCrests(const double ElapsedTime, const FVector& PointA, const FVector& PointB) const
 {
-    for (int32 PeakNumber = 0; PeakNumber < Harmonic; ++PeakNumber)
+    const StringPeakDamage::FSpanSample PreviousSpan{PreviousElapsedTime, PreviousPointA, PreviousPointB};
+    const StringPeakDamage::FSpanSample CurrentSpan{ElapsedTime, PointA, PointB};
+
+    // Every peak of a standing wave crests on the same step, so crests of one step deal damage together like the peaks of the closed form
+    TArray<FVector, TInlineAllocator<8>> PeakPositions;
+    for (int32 Index = 0; Index < SimulatedCrests.Num();)
     {
-        const double PeakOffsetNorm = static_cast<double>(2 * PeakNumber + 1) / static_cast<double>(2 * Harmonic);
-        const double PeakDisplacement = GetNormalizedStringDisplacement(PeakOffsetNorm, PeakTime, Harmonic) * Amplitude;
-        const FVector PeakPosition = UKismetMathLibrary::VLerp(PointA, PointB, PeakOffsetNorm) + StringNormal * PeakDisplacement;
+        const float Age = SimulatedCrests[Index].Age;
+        const StringPeakDamage::FPeakEvent Event = StringPeakDamage::MakePeakEvent(PreviousSpan, CurrentSpan, ElapsedTime - Age);
+
+        PeakPositions.Reset();
+        for (; Index < SimulatedCrests.Num() && SimulatedCrests[Index].Age == Age; ++Index)
+        {
+            const FStringWavePeak& Peak = SimulatedCrests[Index].Peak;
+            PeakPositions.Add(UKismetMathLibrary::VLerp(Event.PointA, Event.PointB, Peak.Position) + Event.StringNormal * (Peak.Displacement * Amplitude));
+        }
+
+        UHitchWatchdogSubsystem::Count(EHitchWatchdogCounter::PeaksFired);
+        DealDamageAtPeaks(Event, PeakPositions, ElapsedTime);
+    }
+}
+
+void UStringAbilityComponent::DisplayDamageTelegraphs(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double TelegraphRadius, const double PeakTime) const
+{
+    TArray<FVector, TInlineAllocator<8>> PeakPositions;
+    GetPeakPositions(PointA, PointB, StringNormal, PeakTime, PeakPositions);
 
+    for (const FVector& PeakPosition : PeakPositions)
+    {
         DrawDebugCircle(GetWorld(), PeakPosition, TelegraphRadius, 32, FColor::Blue, false, -1.0f, 0, 2, FVector::XAxisVector, FVector::YAxisVector, false);
     }
 }
 
-void UStringAbilityComponent::DealDamageAtPeaks(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double PeakTime) const
+void UStringAbilityComponent::DealDamageAtPeaks(const StringPeakDamage::FPeakEvent& Event, const TArrayView<const FVector> PeakPositions, const double ElapsedTime) const
 {
-    for (int32 PeakNumber = 0; PeakNumber < Harmonic; ++PeakNumber)
-    {
-        const double PeakOffsetNorm = static_cast<double>(2 * PeakNumber + 1) / static_cast<double>(2 * Harmonic);
-        const double PeakDisplacement = GetNormalizedStringDisplacement(PeakOffsetNorm, PeakTime, Harmonic) * Amplitude;
-        const FVector PeakPosition = UKismetMathLibrary::VLerp(PointA, PointB, PeakOffsetNorm) + StringNormal * PeakDisplacement;
+    FHitchWatchdogScope HitchScope(EHitchWatchdogTimer::PeakDamage);
+
+    TArray<AActor*> IgnoreActors;
+    AbilityOwnerRef->GetIgnoreDamageActors(IgnoreActors);
+    IgnoreActors.Add(GetOwner());
+
+    FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(StringAbilityDamage), false);
+    QueryParams.AddIgnoredActors(IgnoreActors);
 
+    // Targets may have moved since the peak, so the broadphase is widened by how far they could have gone
+    const double SweepMargin = MaxTargetSpeed * (ElapsedTime - Event.ElapsedTime);
+
+    TArray<FOverlapResult> Overlaps;
+    TArray<AActor*> HitActors;
+
+    for (const FVector& PeakPosition : PeakPositions)
+    {
         DrawDebugCircle(GetWorld(), PeakPosition, DamageRadius, 32, FColor::Red, false, 0.25f, 0, 2, FVector::XAxisVector, FVector::YAxisVector, false);
 
-        TArray<AActor*> IgnoreActors;
-        AbilityOwnerRef->GetIgnoreDamageActors(IgnoreActors);
-        const FVector DamageOrigin = PeakPosition + FVector::ZAxisVector * 34.0;
+        const FVector DamageOrigin = PeakPosition + FVector::ZAxisVector * StringPeakDamage::DamageHeight;
+
+        Overlaps.Reset();
+        GetWorld()->OverlapMultiByObjectType(Overlaps, DamageOrigin, FQuat::Identity, FCollisionObjectQueryParams(FCollisionObjectQueryParams::InitType::AllDynamicObjects), FCollisionShape::MakeSphere(DamageRadius + SweepMargin), QueryParams);
+
+        HitActors.Reset();
+        for (const FOverlapResult& Overlap : Overlaps)
+        {
+            AActor* Actor = Overlap.GetActor();
+            UPrimitiveComponent* Component = Overlap.GetComponent();
+            if (!IsValid(Actor) || !IsValid(Component) || HitActors.Contains(Actor)) { continue; }
+
+            // Move the target back to where it was at the peak
+            const FVector Location = Actor->GetActorLocation();
+            const FVector Rewind = StringPeakDamage::GetLocationAtPeak(Event, ElapsedTime, Location, PreviousTargetLocations.Find(Actor), Actor->GetVelocity()) - Location;
+            if (!IsComponentWithinDamageRadius(Component, Rewind, DamageOrigin)) { continue; }
+
+            // Same blocking rule as radial damage: anything on the visibility channel between the peak and the target shields it
+            FHitResult BlockingHit;
+            if (GetWorld()->LineTraceSingleByChannel(BlockingHit, DamageOrigin, Component->GetComponentLocation() + Rewind, ECC_Visibility, QueryParams) && BlockingHit.GetActor() != Actor) { continue; }
+
+            HitActors.Add(Actor);
+        }
+
+        for (AActor* HitActor : HitActors)
+        {
+            UGameplayStatics::ApplyDamage(HitActor, Damage, GetOwner()->GetInstigatorController(), GetOwner(), UDamageType::StaticClass());
+        }
+    }
+}
+
+void UStringAbilityComponent::GetPeakPositions(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double PeakTime, TArray<FVector, TInlineAllocator<8>>& OutPeakPositions) const
+{
+    OutPeakPositions.Reset();
+
+    // The simulated string has no closed form, so its peaks are the extrema of the current shape
+    if (ShapeMode == EStringShapeMode::Simulated)
+    {
+        for (const FStringWavePeak& Peak : SimulatedPeaks)
+        {
+            OutPeakPositions.Add(UKismetMathLibrary::VLerp(PointA, PointB, Peak.Position) + StringNormal * (Peak.Displacement * Amplitude));
+        }
+
+        return;
+    }
+
+    if (!PeakKernel) { return; }
+
+    // The time only scales the whole wave, so it is folded into a single displacement shared by every peak
+    const FVector Displacement = StringNormal * (static_cast<double>(Amplitude) * FMath::Cos(PeakTime * UE_DOUBLE_TWO_PI));
+
+    OutPeakPositions.SetNumUninitialized(StringPeakKernels::MaxPeaks, EAllowShrinking::No);
+    OutPeakPositions.SetNum(PeakKernel(PointA, PointB - PointA, Displacement, OutPeakPositions.GetData()), EAllowShrinking::No);
+}
 
-        UGameplayStatics::ApplyRadialDamage(this, Damage, DamageOrigin, DamageRadius, UDamageType::StaticClass(), IgnoreActors, GetOwner(), GetOwner()->GetInstigatorController(), true);
+bool UStringAbilityComponent::IsComponentWithinDamageRadius(const UPrimitiveComponent* Component, const FVector& Rewind, const FVector& DamageOrigin) const
+{
+    // Capsules are tested analytically as a segment with a radius, everything else falls back to the collision distance query
+    if (const UCapsuleComponent* Capsule = Cast<UCapsuleComponent>(Component))
+    {
+        const FVector Center = Capsule->GetComponentLocation() + Rewind;
+        const FVector Axis = Capsule->GetUpVector() * Capsule->GetScaledCapsuleHalfHeight_WithoutHemisphere();
+        return StringPeakDamage::IsCapsuleWithinRadius(Center, Axis, Capsule->GetScaledCapsuleRadius(), DamageOrigin, DamageRadius);
     }
+
+    FVector ClosestPoint;
+    const float Distance = Component->GetDistanceToCollision(DamageOrigin - Rewind, ClosestPoint);
+    return Distance >= 0.0f && Distance <= DamageRadius;
 }
 
-// Calculate wave displacement based on the harmonic mode and time progression
-double UStringAbilityComponent::GetNormalizedStringDisplacement(const double NormalizedPosition, const double NormalizedPhase, const int HarmonicMode)
+void UStringAbilityComponent::RecordTargetLocations(const double ElapsedTime, const FVector& PointA, const FVector& PointB)
 {
-    return FMath::Sin(NormalizedPosition * UE_DOUBLE_PI * static_cast<double>(HarmonicMode)) * FMath::Cos(NormalizedPhase * UE_DOUBLE_TWO_PI);
+    PreviousTargetLocations.Reset();
+
+    // Only the last tick before a peak is interpolated from, so the query is skipped for the rest of the cycle.
+    // Crests of the simulated string can come at any time.
+    if (ShapeMode != EStringShapeMode::Simulated && StringPeakDamage::GetTimeToNextPeak(Period, ElapsedTime) > StringPeakDamage::MaxInterpolatedTickTime) { return; }
+
+    TArray<AActor*> IgnoreActors;
+    AbilityOwnerRef->GetIgnoreDamageActors(IgnoreActors);
+    IgnoreActors.Add(GetOwner());
+
+    FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(StringAbilityRecordTargets), false);
+    QueryParams.AddIgnoredActors(IgnoreActors);
+
+    // Covers every peak of the string plus how far targets can get until the peak
+    const double Reach = DamageRadius + MaxTargetSpeed * StringPeakDamage::MaxInterpolatedTickTime;
+    const double Radius = FVector::Dist(PointA, PointB) * 0.5 + Amplitude + StringPeakDamage::DamageHeight + Reach;
+
+    TArray<FOverlapResult> Overlaps;
+    GetWorld()->OverlapMultiByObjectType(Overlaps, (PointA + PointB) * 0.5, FQuat::Identity, FCollisionObjectQueryParams(FCollisionObjectQueryParams::InitType::AllDynamicObjects), FCollisionShape::MakeSphere(Radius), QueryParams);
+
+    for (const FOverlapResult& Overlap : Overlaps)
+    {
+        if (AActor* Actor = Overlap.GetActor(); IsValid(Actor))
+        {
+            PreviousTargetLocations.Add(Actor, Actor->GetActorLocation());
+        }
+    }
+}
+
+void UStringAbilityComponent::DealDamageAlongString(const FVector& PointA, const FVector& PointB)
+{
+    SCOPE_CYCLE_COUNTER(STAT_StringAbilityStringDamage);
+    FHitchWatchdogScope HitchScope(EHitchWatchdogTimer::StringDamage);
+
+    const double Now = GetWorld()->TimeSeconds;
+
+    // Forget enemies whose cooldown ran out, so the map only holds recently hit ones
+    for (auto It = StringHitTimes.CreateIterator(); It; ++It)
+    {
+        if (!It.Key().IsValid() || Now - It.Value() >= StringHitCooldown)
+        {
+            It.RemoveCurrent();
+        }
+    }
+
+    TArray<AActor*> IgnoreActors;
+    AbilityOwnerRef->GetIgnoreDamageActors(IgnoreActors);
+    IgnoreActors.Add(GetOwner());
+
+    FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(StringAbilityStringDamage), false);
+    QueryParams.AddIgnoredActors(IgnoreActors);
+
+    // Broadphase: a single box around the whole swing of the string, widened by how far the span moved since the previous tick
+    const FVector SpanDirection = PointB - PointA;
+    const double SpanMove = FMath::Max(FVector::Dist(PointA, PreviousPointA), FVector::Dist(PointB, PreviousPointB));
+    const FVector BoxExtent(SpanDirection.Size() * 0.5 + StringThickness + SpanMove, Amplitude + StringThickness + SpanMove, StringBroadphaseHalfHeight);
+    const FQuat BoxRotation = FRotationMatrix::MakeFromXZ(SpanDirection, FVector::ZAxisVector).ToQuat();
+    const FVector BoxCenter = (PointA + PointB) * 0.5 + FVector::ZAxisVector * StringBroadphaseHalfHeight * 0.5;
+
+    StringOverlaps.Reset();
+    GetWorld()->OverlapMultiByObjectType(StringOverlaps, BoxCenter, BoxRotation, FCollisionObjectQueryParams(ECC_Pawn), FCollisionShape::MakeBox(BoxExtent), QueryParams);
+
+    StringCapsules.Reset(PointA, SpanDirection);
+    for (int32 Index = 0; Index < StringOverlaps.Num(); ++Index)
+    {
+        const UCapsuleComponent* Capsule = Cast<UCapsuleComponent>(StringOverlaps[Index].GetComponent());
+        if (!IsValid(Capsule) || StringHitTimes.Contains(StringOverlaps[Index].GetActor())) { continue; }
+
+        StringCapsules.Add(Capsule->GetComponentLocation(), Capsule->GetScaledCapsuleHalfHeight_WithoutHemisphere(), Capsule->GetScaledCapsuleRadius(), Index);
+    }
+    StringCapsules.Finalize();
+
+    // The string moves up to 2 * PI * Amplitude / Period per second, much more than its width per tick, so it is swept from where it was
+    StringCapsules.FindSweptHits(PreviousStringPoints, StringPoints, StringThickness, StringHits);
+
+    for (TConstSetBitIterator<> It(StringHits); It; ++It)
+    {
+        AActor* HitActor = StringOverlaps[StringCapsules.GetSourceIndex(It.GetIndex())].GetActor();
+        if (!IsValid(HitActor) || StringHitTimes.Contains(HitActor)) { continue; }
+
+        StringHitTimes.Add(HitActor, Now);
+        UGameplayStatics::ApplyDamage(HitActor, Damage, GetOwner()->GetInstigatorController(), GetOwner(), UDamageType::StaticClass());
+    }
 }
 
 double UStringAbilityComponent::GetPeriod() const
@@ -212,7 +637,22 @@ int32 UStringAbilityComponent::GetHarmonic() const
     return Harmonic;
 }
 
-float UStringAbilityComponent::GetDamageRadius()
+float UStringAbilityComponent::GetDamageRadius() const
 {
     return DamageRadius;
 }
+
+bool UStringAbilityComponent::IsAbilityActive() const
+{
+    return bIsAbilityActive;
+}
+
+double UStringAbilityComponent::GetElapsedTime() const
+{
+    return GetWorld()->TimeSeconds - ActivationTime;
+}
+
+FTickFunction& UStringAbilityComponent::GetSolverTickFunction()
+{
+    return SolverTickFunction;
+}
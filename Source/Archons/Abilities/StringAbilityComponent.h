@@ -3,10 +3,57 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "StringCollision.h"
+#include "StringPeakDamage.h"
+#include "StringPeakKernels.h"
+#include "StringWaveSolver.h"
 #include "Components/ActorComponent.h"
+#include "Engine/OverlapResult.h"
 #include "StringAbilityComponent.generated.h"
 
 class ISpanAbilityOwner;
+class UStringAbilityComponent;
+
+UENUM()
+enum class EStringDamageMode : uint8
+{
+    // Radial damage at the peaks of the wave, after a telegraph
+    Peaks,
+    // Anything the string sweeps through takes damage, once per cooldown
+    String,
+    PeaksAndString
+};
+
+UENUM()
+enum class EStringShapeMode : uint8
+{
+    // A single harmonic as a closed-form standing wave
+    StandingWave,
+    // A damped wave equation where plucked harmonics superpose
+    Simulated
+};
+
+// Steps the simulated string in its own tick ahead of the component tick, which makes the order between the two explicit.
+// It only touches the solver and its input, so it is allowed to run on any thread. No reduction in frame time is claimed, none was measured.
+USTRUCT()
+struct FStringSolverTickFunction : public FTickFunction
+{
+    GENERATED_BODY()
+
+    UStringAbilityComponent* Target = nullptr;
+
+    virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+    virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FStringSolverTickFunction> : public TStructOpsTypeTraitsBase2<FStringSolverTickFunction>
+{
+    enum
+    {
+        WithCopy = false
+    };
+};
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class ARCHONS_API UStringAbilityComponent : public UActorComponent
@@ -36,11 +83,52 @@ class ARCHONS_API UStringAbilityComponent : public UActorComponent
     UPROPERTY(EditAnywhere, meta=(ClampMin=75.0f, ClampMax=150.0f, Delta=5.0))
     float DamageRadius;
 
+    // Upper bound of target speed, used to widen the damage broadphase when a peak is evaluated after it happened
+    UPROPERTY(EditAnywhere, meta=(ClampMin=0.0f))
+    float MaxTargetSpeed;
+
+    UPROPERTY(EditAnywhere, Category="String Damage")
+    EStringDamageMode DamageMode;
+
+    UPROPERTY(EditAnywhere, Category="String Damage", meta=(ClampMin=1, ClampMax=1024))
+    int32 StringCollisionSegments;
+
+    UPROPERTY(EditAnywhere, Category="String Damage", meta=(ClampMin=0.0f))
+    float StringThickness;
+
+    UPROPERTY(EditAnywhere, Category="String Damage", meta=(ClampMin=0.0f))
+    float StringHitCooldown;
+
+    UPROPERTY(EditAnywhere, Category="String Damage", meta=(ClampMin=0.0f))
+    float StringBroadphaseHalfHeight;
+
+    UPROPERTY(EditAnywhere, Category="Simulation")
+    EStringShapeMode ShapeMode;
+
+    UPROPERTY(EditAnywhere, Category="Simulation", meta=(ClampMin=3, ClampMax=2048))
+    int32 SimulationNodes;
+
+    UPROPERTY(EditAnywhere, Category="Simulation", meta=(ClampMin=0.0001f))
+    float SimulationTimeStep;
+
+    UPROPERTY(EditAnywhere, Category="Simulation", meta=(ClampMin=0.0f))
+    float SimulationDamping;
+
+    // Displacement, as a fraction of the amplitude, a peak must reach to be telegraphed and to deal damage when it crests.
+    // Absolute, so near-flat shapes and a string that has rung out deal no damage.
+    UPROPERTY(EditAnywhere, Category="Simulation", meta=(ClampMin=0.01f, ClampMax=1.0f))
+    float SimulationPeakThreshold;
+
 public:
     UStringAbilityComponent();
 
 protected:
     virtual void BeginPlay() override;
+    virtual void RegisterComponentTickFunctions(bool bRegister) override;
+
+#if WITH_EDITOR
+    virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
 
 public:
     virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
@@ -48,12 +136,18 @@ public:
     void ActivateAbility();
     void DeactivateAbility();
 
+    // Puts the ability back into a previously captured state, ElapsedTime being the time since activation
+    void RestoreState(const double InPeriod, const float InAmplitude, const int32 InHarmonic, const float InDamageRadius, const bool bInIsAbilityActive, const double ElapsedTime);
+
     UFUNCTION(BlueprintCallable)
     void UpgradeAbility();
 
     UFUNCTION(BlueprintCallable)
     void DegradeAbility();
 
+    UFUNCTION(BlueprintCallable)
+    void PluckString();
+
     UFUNCTION(BlueprintCallable)
     void EnlargeAbility();
 
@@ -74,13 +168,67 @@ public:
 
 private:
     double ActivationTime;
-    bool bShouldDealDamage;
 
-    void DrawStringSegments(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const int32 NumSegments, const double SegmentDelta, const double AmplitudeModulator) const;
-    void HandleDamageCycle(const double NormalizedCycleTime, const FVector& PointA, const FVector& PointB, const FVector& StringNormal);
+    // State of the previous tick, used to evaluate peaks at their exact time
+    double PreviousElapsedTime;
+    FVector PreviousPointA;
+    FVector PreviousPointB;
+    bool bHasPreviousSample;
+
+    // Locations of the targets near the string at the previous tick, only recorded right before a peak
+    TMap<TWeakObjectPtr<AActor>, FVector> PreviousTargetLocations;
+
+    // Buffers reused every tick by the string damage mode
+    TArray<FVector> StringPoints;
+    TArray<FVector> PreviousStringPoints;
+    TArray<FOverlapResult> StringOverlaps;
+    FStringCollisionCapsules StringCapsules;
+    TBitArray<> StringHits;
+    TMap<TWeakObjectPtr<AActor>, double> StringHitTimes;
+
+    struct FStringSolverInput
+    {
+        bool bSimulate = false;
+        bool bReset = false;
+        TArray<int32, TInlineAllocator<4>> Plucks;
+        float WaveSpeed = 1.0f;
+        float Damping = 0.0f;
+        float PeakThreshold = 0.0f;
+    };
+
+    // Owned by the solver tick, which may run on any thread. The game thread only touches the solver from TickComponent,
+    // which has the solver tick as a prerequisite, and otherwise queues resets and plucks to be handed over there.
+    FStringWaveSolver StringSolver;
+    TArray<FStringWavePeak> SimulatedPeaks;
+    TArray<FStringWaveCrest> SimulatedCrests;
+    FStringSolverInput SolverInput;
+    FStringSolverTickFunction SolverTickFunction;
+
+    bool bPendingSolverReset;
+    TArray<int32, TInlineAllocator<4>> PendingPlucks;
+
+    friend struct FStringSolverTickFunction;
+
+    // Peak kernel of the current harmonic, must be updated whenever the harmonic changes
+    StringPeakKernels::FKernel PeakKernel;
+
+    void UpdatePeakKernel();
+
+    // The ability only evaluates the string and deals damage while debugging
+    bool IsStringEvaluated() const;
+
+    void UpdateSolverInput();
+    void TickSolver(const float DeltaTime);
+    void EvaluateStringSegments(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const int32 NumSegments, const double SegmentDelta, const double AmplitudeModulator);
+    void DrawStringSegments() const;
+    void HandleDamageCycle(const double ElapsedTime, const double NormalizedCycleTime, const FVector& PointA, const FVector& PointB, const FVector& StringNormal);
+    void GetPeakPositions(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double PeakTime, TArray<FVector, TInlineAllocator<8>>& OutPeakPositions) const;
     void DisplayDamageTelegraphs(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double TelegraphRadius, const double PeakTime) const;
-    void DealDamageAtPeaks(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double PeakTime) const;
-    static double GetNormalizedStringDisplacement(const double NormalizedPosition, const double NormalizedPhase, const int HarmonicMode);
+    void DealDamageAtPeaks(const StringPeakDamage::FPeakEvent& Event, const TArrayView<const FVector> PeakPositions, const double ElapsedTime) const;
+    void DealDamageAtCrests(const double ElapsedTime, const FVector& PointA, const FVector& PointB) const;
+    void RecordTargetLocations(const double ElapsedTime, const FVector& PointA, const FVector& PointB);
+    bool IsComponentWithinDamageRadius(const UPrimitiveComponent* Component, const FVector& Rewind, const FVector& DamageOrigin) const;
+    void DealDamageAlongString(const FVector& PointA, const FVector& PointB);
 
 public:
     /** Getters and Setters */
@@ -95,5 +243,9 @@ public:
     int32 GetHarmonic() const;
 
     UFUNCTION(BlueprintCallable, BlueprintPure, DisplayName="Damage Radius")
-    float GetDamageRadius();
+    float GetDamageRadius() const;
+
+    bool IsAbilityActive() const;
+    double GetElapsedTime() const;
+    FTickFunction& GetSolverTickFunction();
 };
@@ -0,0 +1,356 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "StringCollision.h"
+
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+
+namespace
+{
+    // Padding capsules sit far away with no radius, so they can never be hit
+    constexpr float PaddingCoordinate = 1.0e18f;
+
+    // Tests one string segment against capsules [Begin, End), four at a time.
+    // Capsules are upright, so the closest point on the segment is found in the ground plane and the vertical gap to the capsule's axis is added after.
+    void TestSegment(const FVector3f& P0, const FVector3f& Delta, const float InvLengthSquaredXY, const float Thickness,
+        const float* X, const float* Y, const float* ZMin, const float* ZMax, const float* Radius,
+        const int32 Begin, const int32 End, const int32 NumCapsules, TBitArray<>& OutHits)
+    {
+        const VectorRegister4Float Zero = VectorZeroFloat();
+        const VectorRegister4Float One = VectorOneFloat();
+
+        const VectorRegister4Float P0X = VectorSetFloat1(P0.X);
+        const VectorRegister4Float P0Y = VectorSetFloat1(P0.Y);
+        const VectorRegister4Float P0Z = VectorSetFloat1(P0.Z);
+        const VectorRegister4Float DeltaX = VectorSetFloat1(Delta.X);
+        const VectorRegister4Float DeltaY = VectorSetFloat1(Delta.Y);
+        const VectorRegister4Float DeltaZ = VectorSetFloat1(Delta.Z);
+        const VectorRegister4Float InvLength = VectorSetFloat1(InvLengthSquaredXY);
+        const VectorRegister4Float ThicknessV = VectorSetFloat1(Thickness);
+
+        for (int32 Index = Begin; Index < End; Index += 4)
+        {
+            const VectorRegister4Float CenterX = VectorLoadAligned(X + Index);
+            const VectorRegister4Float CenterY = VectorLoadAligned(Y + Index);
+
+            // Parameter of the closest point on the segment, clamped to its ends
+            VectorRegister4Float S = VectorMultiply(VectorMultiplyAdd(VectorSubtract(CenterX, P0X), DeltaX, VectorMultiply(VectorSubtract(CenterY, P0Y), DeltaY)), InvLength);
+            S = VectorMin(VectorMax(S, Zero), One);
+
+            const VectorRegister4Float OffsetX = VectorSubtract(VectorMultiplyAdd(S, DeltaX, P0X), CenterX);
+            const VectorRegister4Float OffsetY = VectorSubtract(VectorMultiplyAdd(S, DeltaY, P0Y), CenterY);
+            const VectorRegister4Float Z = VectorMultiplyAdd(S, DeltaZ, P0Z);
+            const VectorRegister4Float Gap = VectorMax(Zero, VectorMax(VectorSubtract(VectorLoadAligned(ZMin + Index), Z), VectorSubtract(Z, VectorLoadAligned(ZMax + Index))));
+
+            const VectorRegister4Float DistanceSquared = VectorMultiplyAdd(OffsetX, OffsetX, VectorMultiplyAdd(OffsetY, OffsetY, VectorMultiply(Gap, Gap)));
+            const VectorRegister4Float HitRadius = VectorAdd(VectorLoadAligned(Radius + Index), ThicknessV);
+
+            const int32 Mask = VectorMaskBits(VectorCompareLE(DistanceSquared, VectorMultiply(HitRadius, HitRadius)));
+            if (Mask == 0) { continue; }
+
+            for (int32 Lane = 0; Lane < 4; ++Lane)
+            {
+                if ((Mask & (1 << Lane)) != 0 && Index + Lane < NumCapsules)
+                {
+                    OutHits[Index + Lane] = true;
+                }
+            }
+        }
+    }
+
+    void TestSegment(const FVector3f& P0, const FVector3f& P1, const float Thickness,
+        const float* X, const float* Y, const float* ZMin, const float* ZMax, const float* Radius,
+        const int32 Begin, const int32 End, const int32 NumCapsules, TBitArray<>& OutHits)
+    {
+        const FVector3f Delta{P1 - P0};
+        const float LengthSquaredXY{Delta.X * Delta.X + Delta.Y * Delta.Y};
+        const float InvLengthSquaredXY{LengthSquaredXY > UE_SMALL_NUMBER ? 1.0f / LengthSquaredXY : 0.0f};
+
+        TestSegment(P0, Delta, InvLengthSquaredXY, Thickness, X, Y, ZMin, ZMax, Radius, Begin, End, NumCapsules, OutHits);
+    }
+
+    // Lanes whose point lies inside the triangle ABC in the ground plane, for either winding
+    VectorRegister4Float IsInTriangle(const VectorRegister4Float& PX, const VectorRegister4Float& PY, const FVector3f& A, const FVector3f& B, const FVector3f& C)
+    {
+        const VectorRegister4Float Zero = VectorZeroFloat();
+
+        auto Edge = [&PX, &PY](const FVector3f& From, const FVector3f& To)
+        {
+            const VectorRegister4Float ToPointX = VectorSubtract(PX, VectorSetFloat1(From.X));
+            const VectorRegister4Float ToPointY = VectorSubtract(PY, VectorSetFloat1(From.Y));
+            return VectorSubtract(VectorMultiply(VectorSetFloat1(To.X - From.X), ToPointY), VectorMultiply(VectorSetFloat1(To.Y - From.Y), ToPointX));
+        };
+
+        const VectorRegister4Float EdgeAB = Edge(A, B);
+        const VectorRegister4Float EdgeBC = Edge(B, C);
+        const VectorRegister4Float EdgeCA = Edge(C, A);
+
+        const VectorRegister4Float AllLeft = VectorBitwiseAnd(VectorCompareGE(EdgeAB, Zero), VectorBitwiseAnd(VectorCompareGE(EdgeBC, Zero), VectorCompareGE(EdgeCA, Zero)));
+        const VectorRegister4Float AllRight = VectorBitwiseAnd(VectorCompareLE(EdgeAB, Zero), VectorBitwiseAnd(VectorCompareLE(EdgeBC, Zero), VectorCompareLE(EdgeCA, Zero)));
+        return VectorBitwiseOr(AllLeft, AllRight);
+    }
+
+    // Tests capsules [Begin, End) whose axis passes through the quad swept by a segment, four at a time. Seen from above the quad is covered
+    // by all four triangles of its corners, which is the quad itself when convex and its convex hull otherwise, so a twisted sweep can only hit more.
+    // Capsules near its border are left to the edge tests.
+    void TestSweptQuad(const FVector3f (&Corners)[4], const float Thickness,
+        const float* X, const float* Y, const float* ZMin, const float* ZMax, const float* Radius,
+        const int32 Begin, const int32 End, const int32 NumCapsules, TBitArray<>& OutHits)
+    {
+        const VectorRegister4Float Zero = VectorZeroFloat();
+        const VectorRegister4Float ThicknessV = VectorSetFloat1(Thickness);
+
+        const float MinZ{FMath::Min(FMath::Min(Corners[0].Z, Corners[1].Z), FMath::Min(Corners[2].Z, Corners[3].Z))};
+        const float MaxZ{FMath::Max(FMath::Max(Corners[0].Z, Corners[1].Z), FMath::Max(Corners[2].Z, Corners[3].Z))};
+        const VectorRegister4Float MinZV = VectorSetFloat1(MinZ);
+        const VectorRegister4Float MaxZV = VectorSetFloat1(MaxZ);
+
+        for (int32 Index = Begin; Index < End; Index += 4)
+        {
+            const VectorRegister4Float CenterX = VectorLoadAligned(X + Index);
+            const VectorRegister4Float CenterY = VectorLoadAligned(Y + Index);
+
+            VectorRegister4Float Inside = IsInTriangle(CenterX, CenterY, Corners[0], Corners[1], Corners[2]);
+            Inside = VectorBitwiseOr(Inside, IsInTriangle(CenterX, CenterY, Corners[0], Corners[2], Corners[3]));
+            Inside = VectorBitwiseOr(Inside, IsInTriangle(CenterX, CenterY, Corners[0], Corners[1], Corners[3]));
+            Inside = VectorBitwiseOr(Inside, IsInTriangle(CenterX, CenterY, Corners[1], Corners[2], Corners[3]));
+
+            // Right above or below the quad only the vertical gap to the capsule's axis is left, taken against the whole height range of the quad
+            const VectorRegister4Float Gap = VectorMax(Zero, VectorMax(VectorSubtract(VectorLoadAligned(ZMin + Index), MaxZV), VectorSubtract(MinZV, VectorLoadAligned(ZMax + Index))));
+            const VectorRegister4Float InReach = VectorCompareLE(Gap, VectorAdd(VectorLoadAligned(Radius + Index), ThicknessV));
+
+            const int32 Mask = VectorMaskBits(VectorBitwiseAnd(Inside, InReach));
+            if (Mask == 0) { continue; }
+
+            for (int32 Lane = 0; Lane < 4; ++Lane)
+            {
+                if ((Mask & (1 << Lane)) != 0 && Index + Lane < NumCapsules)
+                {
+                    OutHits[Index + Lane] = true;
+                }
+            }
+        }
+    }
+}
+
+void FStringCollisionCapsules::Reset(const FVector& InOrigin, const FVector& InDirection)
+{
+    Origin = InOrigin;
+    Direction = InDirection.GetSafeNormal2D();
+    MaxRadius = 0.0f;
+    NumCapsules = 0;
+
+    Entries.Reset();
+}
+
+void FStringCollisionCapsules::Add(const FVector& Center, const float HalfHeightWithoutHemisphere, const float CapsuleRadius, const int32 SourceIndex)
+{
+    const FVector3f RelativeCenter{Center - Origin};
+    const float AlongString{FVector3f::DotProduct(RelativeCenter, FVector3f(Direction))};
+
+    Entries.Add({AlongString, RelativeCenter, HalfHeightWithoutHemisphere, CapsuleRadius, SourceIndex});
+    MaxRadius = FMath::Max(MaxRadius, CapsuleRadius);
+}
+
+void FStringCollisionCapsules::Finalize()
+{
+    Algo::SortBy(Entries, &FEntry::Along);
+
+    NumCapsules = Entries.Num();
+    const int32 PaddedNum{Align(NumCapsules, 4)};
+
+    Along.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+    X.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+    Y.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+    ZMin.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+    ZMax.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+    Radius.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+    SourceIndices.SetNumUninitialized(NumCapsules, EAllowShrinking::No);
+
+    for (int32 Index = 0; Index < NumCapsules; ++Index)
+    {
+        const FEntry& Entry{Entries[Index]};
+        Along[Index] = Entry.Along;
+        X[Index] = Entry.Center.X;
+        Y[Index] = Entry.Center.Y;
+        ZMin[Index] = Entry.Center.Z - Entry.HalfHeight;
+        ZMax[Index] = Entry.Center.Z + Entry.HalfHeight;
+        Radius[Index] = Entry.Radius;
+        SourceIndices[Index] = Entry.SourceIndex;
+    }
+
+    for (int32 Index = NumCapsules; Index < PaddedNum; ++Index)
+    {
+        Along[Index] = MAX_flt;
+        X[Index] = PaddingCoordinate;
+        Y[Index] = PaddingCoordinate;
+        ZMin[Index] = PaddingCoordinate;
+        ZMax[Index] = PaddingCoordinate;
+        Radius[Index] = 0.0f;
+    }
+}
+
+int32 FStringCollisionCapsules::Num() const
+{
+    return NumCapsules;
+}
+
+int32 FStringCollisionCapsules::GetSourceIndex(const int32 Index) const
+{
+    return SourceIndices[Index];
+}
+
+void FStringCollisionCapsules::FindHits(const TArrayView<const FVector> StringPoints, const float Thickness, TBitArray<>& OutHits) const
+{
+    OutHits.Init(false, NumCapsules);
+    AddHits(StringPoints, Thickness, OutHits);
+}
+
+void FStringCollisionCapsules::FindSweptHits(const TArrayView<const FVector> PreviousPoints, const TArrayView<const FVector> StringPoints, const float Thickness, TBitArray<>& OutHits) const
+{
+    OutHits.Init(false, NumCapsules);
+
+    if (NumCapsules == 0 || StringPoints.Num() < 2) { return; }
+
+    if (PreviousPoints.Num() != StringPoints.Num())
+    {
+        AddHits(StringPoints, Thickness, OutHits);
+        return;
+    }
+
+    const TArrayView<const float> SortedAlong{Along.GetData(), NumCapsules};
+    const FVector3f Direction3f{Direction};
+    const float Reach{MaxRadius + Thickness};
+
+    for (int32 Segment = 0; Segment + 1 < StringPoints.Num(); ++Segment)
+    {
+        // Corners in order around the quad swept by the segment
+        const FVector3f Corners[4]{
+            FVector3f(PreviousPoints[Segment] - Origin),
+            FVector3f(PreviousPoints[Segment + 1] - Origin),
+            FVector3f(StringPoints[Segment + 1] - Origin),
+            FVector3f(StringPoints[Segment] - Origin)
+        };
+
+        float MinAlong{MAX_flt};
+        float MaxAlong{-MAX_flt};
+        for (const FVector3f& Corner : Corners)
+        {
+            const float CornerAlong{FVector3f::DotProduct(Corner, Direction3f)};
+            MinAlong = FMath::Min(MinAlong, CornerAlong);
+            MaxAlong = FMath::Max(MaxAlong, CornerAlong);
+        }
+
+        const int32 Begin{AlignDown(static_cast<int32>(Algo::LowerBound(SortedAlong, MinAlong - Reach)), 4)};
+        const int32 End{Align(static_cast<int32>(Algo::UpperBound(SortedAlong, MaxAlong + Reach)), 4)};
+
+        if (Begin >= End) { continue; }
+
+        // The segment at both ends of the move and the paths of its two points bound the quad
+        for (int32 Corner = 0; Corner < 4; ++Corner)
+        {
+            TestSegment(Corners[Corner], Corners[(Corner + 1) % 4], Thickness, X.GetData(), Y.GetData(), ZMin.GetData(), ZMax.GetData(), Radius.GetData(), Begin, End, NumCapsules, OutHits);
+        }
+
+        TestSweptQuad(Corners, Thickness, X.GetData(), Y.GetData(), ZMin.GetData(), ZMax.GetData(), Radius.GetData(), Begin, End, NumCapsules, OutHits);
+    }
+}
+
+void FStringCollisionCapsules::AddHits(const TArrayView<const FVector> StringPoints, const float Thickness, TBitArray<>& OutHits) const
+{
+    if (NumCapsules == 0 || StringPoints.Num() < 2) { return; }
+
+    const TArrayView<const float> SortedAlong{Along.GetData(), NumCapsules};
+    const FVector3f Direction3f{Direction};
+    const float Reach{MaxRadius + Thickness};
+
+    for (int32 Segment = 0; Segment + 1 < StringPoints.Num(); ++Segment)
+    {
+        const FVector3f P0{StringPoints[Segment] - Origin};
+        const FVector3f P1{StringPoints[Segment + 1] - Origin};
+
+        // Only capsules whose position along the string overlaps the segment can touch it
+        const float Along0{FVector3f::DotProduct(P0, Direction3f)};
+        const float Along1{FVector3f::DotProduct(P1, Direction3f)};
+        const int32 Begin{AlignDown(static_cast<int32>(Algo::LowerBound(SortedAlong, FMath::Min(Along0, Along1) - Reach)), 4)};
+        const int32 End{Align(static_cast<int32>(Algo::UpperBound(SortedAlong, FMath::Max(Along0, Along1) + Reach)), 4)};
+
+        if (Begin >= End) { continue; }
+
+        TestSegment(P0, P1, Thickness, X.GetData(), Y.GetData(), ZMin.GetData(), ZMax.GetData(), Radius.GetData(), Begin, End, NumCapsules, OutHits);
+    }
+}
+
+// Compares the cost of the full string test against the peak sphere test on synthetic enemies spread around a string
+static FAutoConsoleCommand BenchmarkStringCollisionCommand(
+    TEXT("Archons.String.BenchmarkCollision"),
+    TEXT("Archons.String.BenchmarkCollision [Enemies=2000] [Segments=128] [Iterations=100]"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+    {
+        const int32 NumEnemies{Args.IsValidIndex(0) ? FCString::Atoi(*Args[0]) : 2000};
+        const int32 NumSegments{FMath::Max(Args.IsValidIndex(1) ? FCString::Atoi(*Args[1]) : 128, 1)};
+        const int32 Iterations{FMath::Max(Args.IsValidIndex(2) ? FCString::Atoi(*Args[2]) : 100, 1)};
+
+        constexpr double StringLength = 1500.0;
+        constexpr double Amplitude = 100.0;
+        constexpr int32 Harmonic = 5;
+        constexpr float Thickness = 10.0f;
+        constexpr float CapsuleRadius = 34.0f;
+        constexpr float CapsuleHalfHeight = 54.0f;
+        constexpr double PeakRadius = 75.0;
+
+        FRandomStream Random(1234);
+        TArray<FVector> Centers;
+        for (int32 Index = 0; Index < NumEnemies; ++Index)
+        {
+            Centers.Add(FVector(Random.FRandRange(-500.0, StringLength + 500.0), Random.FRandRange(-1000.0, 1000.0), CapsuleHalfHeight + CapsuleRadius));
+        }
+
+        TArray<FVector> StringPoints;
+        for (int32 Segment = 0; Segment <= NumSegments; ++Segment)
+        {
+            const double Offset{static_cast<double>(Segment) / static_cast<double>(NumSegments)};
+            StringPoints.Add(FVector(Offset * StringLength, FMath::Sin(Offset * UE_DOUBLE_PI * Harmonic) * Amplitude, 0.0));
+        }
+
+        FStringCollisionCapsules Capsules;
+        TBitArray<> Hits;
+        int32 StringHits{0};
+
+        const double StringStartTime{FPlatformTime::Seconds()};
+        for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            Capsules.Reset(FVector::ZeroVector, FVector::XAxisVector);
+            for (int32 Index = 0; Index < Centers.Num(); ++Index)
+            {
+                Capsules.Add(Centers[Index], CapsuleHalfHeight, CapsuleRadius, Index);
+            }
+            Capsules.Finalize();
+            Capsules.FindHits(StringPoints, Thickness, Hits);
+            StringHits = Hits.CountSetBits();
+        }
+        const double StringTime{(FPlatformTime::Seconds() - StringStartTime) / Iterations};
+
+        int32 PeakHits{0};
+        const double PeakStartTime{FPlatformTime::Seconds()};
+        for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            PeakHits = 0;
+            for (int32 PeakNumber = 0; PeakNumber < Harmonic; ++PeakNumber)
+            {
+                const double PeakOffsetNorm{static_cast<double>(2 * PeakNumber + 1) / static_cast<double>(2 * Harmonic)};
+                const FVector PeakPosition{PeakOffsetNorm * StringLength, (PeakNumber % 2 == 0 ? 1.0 : -1.0) * Amplitude, 34.0};
+
+                for (const FVector& Center : Centers)
+                {
+                    const FVector Axis{0.0, 0.0, CapsuleHalfHeight};
+                    const FVector ClosestPoint{FMath::ClosestPointOnSegment(PeakPosition, Center - Axis, Center + Axis)};
+                    PeakHits += FVector::DistSquared(PeakPosition, ClosestPoint) <= FMath::Square(PeakRadius + CapsuleRadius) ? 1 : 0;
+                }
+            }
+        }
+        const double PeakTime{(FPlatformTime::Seconds() - PeakStartTime) / Iterations};
+
+        UE_LOG(LogTemp, Display, TEXT("%i enemies, %i segments: string %.3f ms (%i hits), %i peak spheres %.3f ms (%i hits)"),
+            NumEnemies, NumSegments, StringTime * 1000.0, StringHits, Harmonic, PeakTime * 1000.0, PeakHits);
+    }));
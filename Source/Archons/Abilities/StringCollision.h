@@ -0,0 +1,54 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Upright capsules gathered from the broadphase, stored as structure of arrays relative to the string origin.
+ * Capsules are sorted by their distance along the string, so every string segment only tests a contiguous range of them.
+ * Arrays are padded to a multiple of four with capsules that can never be hit, which lets the kernel work four capsules at a time.
+ */
+struct ARCHONS_API FStringCollisionCapsules
+{
+    void Reset(const FVector& InOrigin, const FVector& InDirection);
+    void Add(const FVector& Center, const float HalfHeightWithoutHemisphere, const float Radius, const int32 SourceIndex);
+    void Finalize();
+
+    int32 Num() const;
+    int32 GetSourceIndex(const int32 Index) const;
+
+    // Marks in OutHits (indexed like the sorted capsules) every capsule touched by the polyline thickened by Thickness
+    void FindHits(const TArrayView<const FVector> StringPoints, const float Thickness, TBitArray<>& OutHits) const;
+
+    // Same for a string that moved from PreviousPoints to StringPoints since the last test. Every segment is tested against the quad it swept,
+    // so every capsule the string passed over is hit, not only the ones touching it at either end.
+    void FindSweptHits(const TArrayView<const FVector> PreviousPoints, const TArrayView<const FVector> StringPoints, const float Thickness, TBitArray<>& OutHits) const;
+
+private:
+    struct FEntry
+    {
+        float Along;
+        FVector3f Center;
+        float HalfHeight;
+        float Radius;
+        int32 SourceIndex;
+    };
+
+    void AddHits(const TArrayView<const FVector> StringPoints, const float Thickness, TBitArray<>& OutHits) const;
+
+    FVector Origin = FVector::ZeroVector;
+    FVector Direction = FVector::XAxisVector;
+    float MaxRadius = 0.0f;
+    int32 NumCapsules = 0;
+
+    TArray<FEntry> Entries;
+
+    TArray<float, TAlignedHeapAllocator<16>> Along;
+    TArray<float, TAlignedHeapAllocator<16>> X;
+    TArray<float, TAlignedHeapAllocator<16>> Y;
+    TArray<float, TAlignedHeapAllocator<16>> ZMin;
+    TArray<float, TAlignedHeapAllocator<16>> ZMax;
+    TArray<float, TAlignedHeapAllocator<16>> Radius;
+    TArray<int32> SourceIndices;
+};
@@ -0,0 +1,61 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "StringPeakDamage.h"
+
+namespace
+{
+    // More peaks than this between two ticks means a hitch, the older ones are dropped
+    constexpr int64 MaxPeaksPerTick = 4;
+}
+
+StringPeakDamage::FPeakEvent StringPeakDamage::MakePeakEvent(const FSpanSample& Previous, const FSpanSample& Current, const double ElapsedTime)
+{
+    const double TickDuration = Current.ElapsedTime - Previous.ElapsedTime;
+
+    FPeakEvent Event;
+    Event.ElapsedTime = ElapsedTime;
+    Event.Alpha = TickDuration > 0.0 ? FMath::Clamp((ElapsedTime - Previous.ElapsedTime) / TickDuration, 0.0, 1.0) : 1.0;
+    Event.PointA = FMath::Lerp(Previous.PointA, Current.PointA, Event.Alpha);
+    Event.PointB = FMath::Lerp(Previous.PointB, Current.PointB, Event.Alpha);
+    Event.StringNormal = FVector::CrossProduct(Event.PointB - Event.PointA, FVector::ZAxisVector).GetSafeNormal();
+    return Event;
+}
+
+void StringPeakDamage::FindPeakEvents(const double Period, const FSpanSample& Previous, const FSpanSample& Current, FPeakEvents& OutEvents)
+{
+    OutEvents.Reset();
+
+    const double HalfPeriod = Period * 0.5;
+    const int64 PreviousPeakIndex = FMath::FloorToInt64(Previous.ElapsedTime / HalfPeriod);
+    const int64 CurrentPeakIndex = FMath::FloorToInt64(Current.ElapsedTime / HalfPeriod);
+    const int64 FirstPeakIndex = FMath::Max3(PreviousPeakIndex + 1, CurrentPeakIndex - MaxPeaksPerTick + 1, static_cast<int64>(1));
+
+    for (int64 PeakIndex = FirstPeakIndex; PeakIndex <= CurrentPeakIndex; ++PeakIndex)
+    {
+        FPeakEvent& Event = OutEvents.Add_GetRef(MakePeakEvent(Previous, Current, static_cast<double>(PeakIndex) * HalfPeriod));
+        Event.PeakIndex = PeakIndex;
+        Event.PeakTime = (PeakIndex % 2 == 0) ? PeakTime1 : PeakTime2;
+    }
+}
+
+double StringPeakDamage::GetTimeToNextPeak(const double Period, const double ElapsedTime)
+{
+    const double HalfPeriod = Period * 0.5;
+    return (FMath::FloorToDouble(ElapsedTime / HalfPeriod) + 1.0) * HalfPeriod - ElapsedTime;
+}
+
+FVector StringPeakDamage::GetLocationAtPeak(const FPeakEvent& Event, const double CurrentElapsedTime, const FVector& Location, const FVector* PreviousLocation, const FVector& Velocity)
+{
+    if (PreviousLocation)
+    {
+        return FMath::Lerp(*PreviousLocation, Location, Event.Alpha);
+    }
+
+    return Location - Velocity * (CurrentElapsedTime - Event.ElapsedTime);
+}
+
+bool StringPeakDamage::IsCapsuleWithinRadius(const FVector& Center, const FVector& HalfAxis, const double CapsuleRadius, const FVector& Origin, const double Radius)
+{
+    const FVector ClosestPoint = FMath::ClosestPointOnSegment(Origin, Center - HalfAxis, Center + HalfAxis);
+    return FVector::DistSquared(Origin, ClosestPoint) <= FMath::Square(Radius + CapsuleRadius);
+}
@@ -0,0 +1,63 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Timing and hit math of the peak damage, kept apart from the world so it can be driven with synthetic spans and targets.
+ *
+ * Peaks happen every half period. Every peak passed between two ticks is evaluated at its exact time, with the span
+ * interpolated between the two ticks and every target moved to where it was at that moment, so hits don't depend on the tick rate.
+ */
+namespace StringPeakDamage
+{
+    // Normalized cycle times of the two peaks of a period
+    constexpr double PeakTime1 = 1.0;
+    constexpr double PeakTime2 = 0.5;
+
+    // Damage is centered this high above the string
+    constexpr double DamageHeight = 34.0;
+
+    // Peaks further apart from a tick than this can't interpolate targets and rewind them along their velocity instead
+    constexpr double MaxInterpolatedTickTime = 0.25;
+
+    struct FSpanSample
+    {
+        double ElapsedTime = 0.0;
+        FVector PointA = FVector::ZeroVector;
+        FVector PointB = FVector::ZeroVector;
+    };
+
+    struct FPeakEvent
+    {
+        int64 PeakIndex = 0;
+        double ElapsedTime = 0.0;
+        double PeakTime = PeakTime1;
+
+        // Position of the peak between the previous and the current sample
+        double Alpha = 1.0;
+
+        FVector PointA = FVector::ZeroVector;
+        FVector PointB = FVector::ZeroVector;
+        FVector StringNormal = FVector::ZeroVector;
+    };
+
+    using FPeakEvents = TArray<FPeakEvent, TInlineAllocator<4>>;
+
+    // Span at a time between two samples, for peaks that happen off the schedule
+    ARCHONS_API FPeakEvent MakePeakEvent(const FSpanSample& Previous, const FSpanSample& Current, const double ElapsedTime);
+
+    // Peak 0 is the activation itself and never fires
+    ARCHONS_API void FindPeakEvents(const double Period, const FSpanSample& Previous, const FSpanSample& Current, FPeakEvents& OutEvents);
+
+    // Time from ElapsedTime until the next peak
+    ARCHONS_API double GetTimeToNextPeak(const double Period, const double ElapsedTime);
+
+    // Where a target was at the peak. Interpolated between its location at the previous and the current sample when the previous one is known,
+    // rewound along its current velocity otherwise, which is off by up to the change in velocity times the time since the peak.
+    ARCHONS_API FVector GetLocationAtPeak(const FPeakEvent& Event, const double CurrentElapsedTime, const FVector& Location, const FVector* PreviousLocation, const FVector& Velocity);
+
+    // Upright capsule given by its center, the half axis between the hemisphere centers and its radius
+    ARCHONS_API bool IsCapsuleWithinRadius(const FVector& Center, const FVector& HalfAxis, const double CapsuleRadius, const FVector& Origin, const double Radius);
+}
@@ -0,0 +1,77 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "StringPeakKernels.h"
+
+#include "Kismet/KismetMathLibrary.h"
+
+int32 StringPeakKernels::EvaluateClosedForm(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double Amplitude, const double PeakTime, const int32 HarmonicMode, FVector* OutPositions)
+{
+    for (int32 PeakNumber = 0; PeakNumber < HarmonicMode; ++PeakNumber)
+    {
+        const double PeakOffsetNorm = static_cast<double>(2 * PeakNumber + 1) / static_cast<double>(2 * HarmonicMode);
+        const double PeakDisplacement = FMath::Sin(PeakOffsetNorm * UE_DOUBLE_PI * static_cast<double>(HarmonicMode)) * FMath::Cos(PeakTime * UE_DOUBLE_TWO_PI) * Amplitude;
+        OutPositions[PeakNumber] = UKismetMathLibrary::VLerp(PointA, PointB, PeakOffsetNorm) + StringNormal * PeakDisplacement;
+    }
+
+    return HarmonicMode;
+}
+
+// Compares the cost of every kernel against the closed-form evaluation on random spans
+static FAutoConsoleCommand BenchmarkPeakKernelsCommand(
+    TEXT("Archons.String.BenchmarkPeakKernels"),
+    TEXT("Archons.String.BenchmarkPeakKernels [Spans=100000]"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+    {
+        const int32 NumSpans{FMath::Max(Args.IsValidIndex(0) ? FCString::Atoi(*Args[0]) : 100000, 1)};
+
+        struct FSpan
+        {
+            FVector PointA;
+            FVector PointB;
+            FVector StringNormal;
+            double Amplitude;
+            double PeakTime;
+        };
+
+        FRandomStream Random(1234);
+        TArray<FSpan> Spans;
+        Spans.Reserve(NumSpans);
+        for (int32 Index = 0; Index < NumSpans; ++Index)
+        {
+            FSpan& Span{Spans.AddDefaulted_GetRef()};
+            Span.PointA = FVector(Random.FRandRange(-5000.0, 5000.0), Random.FRandRange(-5000.0, 5000.0), Random.FRandRange(0.0, 200.0));
+            Span.PointB = Span.PointA + FVector(Random.GetUnitVector().GetSafeNormal2D() * Random.FRandRange(100.0, 2000.0));
+            Span.StringNormal = FVector::CrossProduct(Span.PointB - Span.PointA, FVector::ZAxisVector).GetSafeNormal();
+            Span.Amplitude = Random.FRandRange(75.0, 200.0);
+            Span.PeakTime = Index % 2 == 0 ? 1.0 : 0.5;
+        }
+
+        FVector ReferencePositions[StringPeakKernels::MaxPeaks];
+        FVector KernelPositions[StringPeakKernels::MaxPeaks];
+
+        for (int32 HarmonicMode = StringPeakKernels::MinHarmonic; HarmonicMode <= StringPeakKernels::MaxHarmonic; ++HarmonicMode)
+        {
+            const StringPeakKernels::FKernel Kernel{StringPeakKernels::GetKernel(HarmonicMode)};
+
+            double Checksum{0.0};
+
+            const double ReferenceStartTime{FPlatformTime::Seconds()};
+            for (const FSpan& Span : Spans)
+            {
+                StringPeakKernels::EvaluateClosedForm(Span.PointA, Span.PointB, Span.StringNormal, Span.Amplitude, Span.PeakTime, HarmonicMode, ReferencePositions);
+                Checksum += ReferencePositions[HarmonicMode - 1].X;
+            }
+            const double ReferenceMs{(FPlatformTime::Seconds() - ReferenceStartTime) * 1000.0};
+
+            const double KernelStartTime{FPlatformTime::Seconds()};
+            for (const FSpan& Span : Spans)
+            {
+                Kernel(Span.PointA, Span.PointB - Span.PointA, Span.StringNormal * (Span.Amplitude * FMath::Cos(Span.PeakTime * UE_DOUBLE_TWO_PI)), KernelPositions);
+                Checksum += KernelPositions[HarmonicMode - 1].X;
+            }
+            const double KernelMs{(FPlatformTime::Seconds() - KernelStartTime) * 1000.0};
+
+            UE_LOG(LogTemp, Display, TEXT("Harmonic %i: closed form %.3f ms, kernel %.3f ms for %i spans (checksum %g)"),
+                HarmonicMode, ReferenceMs, KernelMs, NumSpans, Checksum);
+        }
+    }));
@@ -0,0 +1,78 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/IntegerSequence.h"
+
+/**
+ * Peak positions of the standing wave, specialized per harmonic. Peak k of harmonic H sits at (2k + 1) / (2H) along the span,
+ * where sin((2k + 1) * PI / 2) is exactly +1 or -1, so both the offsets and the signs are compile-time tables and every peak is
+ * a pair of multiply-adds. The kernel for the current harmonic is picked once through GetKernel whenever the harmonic changes.
+ *
+ * Tested against the closed-form evaluation by Archons.String.PeakKernels.MatchClosedForm, timed by Archons.String.BenchmarkPeakKernels.
+ */
+namespace StringPeakKernels
+{
+    constexpr int32 MinHarmonic = 2;
+    constexpr int32 MaxHarmonic = 5;
+    constexpr int32 MaxPeaks = MaxHarmonic;
+
+    template <int32 HarmonicMode>
+    struct TPeakTable
+    {
+        static_assert(HarmonicMode >= MinHarmonic && HarmonicMode <= MaxHarmonic, "Harmonic has no peak kernel");
+
+        struct FData
+        {
+            double Offsets[HarmonicMode];
+            double Signs[HarmonicMode];
+        };
+
+        static constexpr FData Make()
+        {
+            FData Data{};
+            for (int32 PeakNumber = 0; PeakNumber < HarmonicMode; ++PeakNumber)
+            {
+                Data.Offsets[PeakNumber] = static_cast<double>(2 * PeakNumber + 1) / static_cast<double>(2 * HarmonicMode);
+                Data.Signs[PeakNumber] = PeakNumber % 2 == 0 ? 1.0 : -1.0;
+            }
+            return Data;
+        }
+
+        static constexpr FData Data = Make();
+    };
+
+    static_assert(TPeakTable<2>::Data.Offsets[1] == 0.75 && TPeakTable<2>::Data.Signs[1] == -1.0);
+    static_assert(TPeakTable<4>::Data.Offsets[0] == 0.125 && TPeakTable<4>::Data.Signs[2] == 1.0);
+
+    // Writes one position per peak and returns how many were written.
+    // Displacement is the string normal scaled by the amplitude at the evaluated time, i.e. the offset of the first peak from the span.
+    using FKernel = int32 (*)(const FVector& PointA, const FVector& Span, const FVector& Displacement, FVector* OutPositions);
+
+    template <int32 HarmonicMode, int32... PeakNumbers>
+    FORCEINLINE void EvaluatePeaks(const FVector& PointA, const FVector& Span, const FVector& Displacement, FVector* OutPositions, TIntegerSequence<int32, PeakNumbers...>)
+    {
+        using FTable = TPeakTable<HarmonicMode>;
+        ((OutPositions[PeakNumbers] = PointA + Span * FTable::Data.Offsets[PeakNumbers] + Displacement * FTable::Data.Signs[PeakNumbers]), ...);
+    }
+
+    template <int32 HarmonicMode>
+    int32 Evaluate(const FVector& PointA, const FVector& Span, const FVector& Displacement, FVector* OutPositions)
+    {
+        EvaluatePeaks<HarmonicMode>(PointA, Span, Displacement, OutPositions, TMakeIntegerSequence<int32, HarmonicMode>());
+        return HarmonicMode;
+    }
+
+    // The evaluation the kernels replace, kept as the reference they are tested against
+    ARCHONS_API int32 EvaluateClosedForm(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double Amplitude, const double PeakTime, const int32 HarmonicMode, FVector* OutPositions);
+
+    // Returns nullptr for harmonics without a kernel
+    inline FKernel GetKernel(const int32 HarmonicMode)
+    {
+        static constexpr FKernel Kernels[]{&Evaluate<2>, &Evaluate<3>, &Evaluate<4>, &Evaluate<5>};
+        static_assert(UE_ARRAY_COUNT(Kernels) == MaxHarmonic - MinHarmonic + 1);
+
+        return HarmonicMode >= MinHarmonic && HarmonicMode <= MaxHarmonic ? Kernels[HarmonicMode - MinHarmonic] : nullptr;
+    }
+}
@@ -0,0 +1,260 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "StringWaveSolver.h"
+
+namespace
+{
+    // Long hitches drop simulated time instead of stalling the frame even further
+    constexpr int32 MaxStepsPerAdvance = 32;
+}
+
+void FStringWaveSolver::Initialize(const int32 InNumNodes, const float InTimeStep)
+{
+    NumNodes = FMath::Max(InNumNodes, 3);
+    TimeStep = FMath::Max(InTimeStep, UE_KINDA_SMALL_NUMBER);
+
+    Previous.SetNumZeroed(NumNodes);
+    Current.SetNumZeroed(NumNodes);
+    Next.SetNumZeroed(NumNodes);
+
+    // A standing wave crests at every peak at once, more than this per Advance are dropped
+    Crests.Reset(NumNodes);
+
+    Reset();
+}
+
+void FStringWaveSolver::Reset()
+{
+    FMemory::Memzero(Previous.GetData(), Previous.Num() * sizeof(float));
+    FMemory::Memzero(Current.GetData(), Current.Num() * sizeof(float));
+    FMemory::Memzero(Next.GetData(), Next.Num() * sizeof(float));
+
+    Accumulator = 0.0f;
+    Crests.Reset();
+}
+
+void FStringWaveSolver::SetWaveSpeed(const float InWaveSpeed)
+{
+    WaveSpeed = FMath::Max(InWaveSpeed, 0.0f);
+}
+
+void FStringWaveSolver::SetDamping(const float InDamping)
+{
+    Damping = FMath::Max(InDamping, 0.0f);
+}
+
+void FStringWaveSolver::SetCrestThreshold(const float InCrestThreshold)
+{
+    CrestThreshold = FMath::Max(InCrestThreshold, 0.0f);
+}
+
+void FStringWaveSolver::Pluck(const int32 Harmonic, const float Amplitude)
+{
+    const float NodeDelta{1.0f / static_cast<float>(NumNodes - 1)};
+
+    for (int32 Node = 1; Node < NumNodes - 1; ++Node)
+    {
+        const float Displacement{FMath::Sin(static_cast<float>(Node) * NodeDelta * UE_PI * static_cast<float>(Harmonic)) * Amplitude};
+        Previous[Node] += Displacement;
+        Current[Node] += Displacement;
+    }
+}
+
+void FStringWaveSolver::Advance(const float DeltaTime)
+{
+    if (NumNodes == 0) { return; }
+
+    Crests.Reset();
+    Accumulator += DeltaTime;
+
+    const int32 NumSubsteps{GetNumSubsteps()};
+    const float SubstepTime{TimeStep / static_cast<float>(NumSubsteps)};
+
+    int32 Steps{0};
+    float Time{0.0f};
+    while (Accumulator >= TimeStep && Steps < MaxStepsPerAdvance)
+    {
+        for (int32 Substep = 0; Substep < NumSubsteps; ++Substep)
+        {
+            Step(SubstepTime);
+            Time += SubstepTime;
+
+            if (CrestThreshold > 0.0f)
+            {
+                // The step just taken decides whether the one before it was a crest
+                FindCrests(Time - SubstepTime);
+            }
+        }
+
+        Accumulator -= TimeStep;
+        ++Steps;
+    }
+
+    Accumulator = FMath::Min(Accumulator, TimeStep);
+
+    // The simulation trails the game time by whatever is left in the accumulator
+    for (FStringWaveCrest& Crest : Crests)
+    {
+        Crest.Age = Time - Crest.Age + Accumulator;
+    }
+}
+
+float FStringWaveSolver::Sample(const float Position) const
+{
+    if (NumNodes == 0) { return 0.0f; }
+
+    const float NodePosition{FMath::Clamp(Position, 0.0f, 1.0f) * static_cast<float>(NumNodes - 1)};
+    const int32 Node{FMath::Min(FMath::FloorToInt32(NodePosition), NumNodes - 2)};
+
+    return FMath::Lerp(Current[Node], Current[Node + 1], NodePosition - static_cast<float>(Node));
+}
+
+void FStringWaveSolver::FindPeaks(const float MinDisplacement, TArray<FStringWavePeak>& OutPeaks) const
+{
+    OutPeaks.Reset();
+
+    const float NodeDelta{1.0f / static_cast<float>(NumNodes - 1)};
+
+    for (int32 Node = 1; Node < NumNodes - 1; ++Node)
+    {
+        const float Magnitude{FMath::Abs(Current[Node])};
+        if (Magnitude < MinDisplacement) { continue; }
+
+        // Ties on a flat top are resolved to the first node
+        if (Magnitude >= FMath::Abs(Current[Node - 1]) && Magnitude > FMath::Abs(Current[Node + 1]))
+        {
+            OutPeaks.Add({static_cast<float>(Node) * NodeDelta, Current[Node]});
+        }
+    }
+}
+
+const TArray<FStringWaveCrest>& FStringWaveSolver::GetCrests() const
+{
+    return Crests;
+}
+
+int32 FStringWaveSolver::GetNumNodes() const
+{
+    return NumNodes;
+}
+
+int32 FStringWaveSolver::GetNumSubsteps() const
+{
+    // The Courant number r = c*dt/dx must stay at or below 1, the stability limit of the scheme
+    const float NodeDelta{1.0f / static_cast<float>(NumNodes - 1)};
+    return FMath::Max(FMath::CeilToInt32(WaveSpeed * TimeStep / NodeDelta - UE_KINDA_SMALL_NUMBER), 1);
+}
+
+void FStringWaveSolver::Step(const float StepTime)
+{
+    // u_next * (1 + b*dt) = 2*u - u_prev * (1 - b*dt) + r^2 * (u_left - 2*u + u_right), with r = c*dt/dx
+    const float NodeDelta{1.0f / static_cast<float>(NumNodes - 1)};
+    const float Courant{WaveSpeed * StepTime / NodeDelta};
+    checkSlow(Courant <= 1.0f + UE_KINDA_SMALL_NUMBER);
+
+    const float CourantSquared{Courant * Courant};
+    const float DampingTerm{Damping * StepTime};
+    const float InvNextScale{1.0f / (1.0f + DampingTerm)};
+
+    const float CenterScale{(2.0f - 2.0f * CourantSquared) * InvNextScale};
+    const float NeighbourScale{CourantSquared * InvNextScale};
+    const float PreviousScale{-(1.0f - DampingTerm) * InvNextScale};
+
+    const VectorRegister4Float CenterScaleV = VectorSetFloat1(CenterScale);
+    const VectorRegister4Float NeighbourScaleV = VectorSetFloat1(NeighbourScale);
+    const VectorRegister4Float PreviousScaleV = VectorSetFloat1(PreviousScale);
+
+    const float* RESTRICT U{Current.GetData()};
+    const float* RESTRICT UPrevious{Previous.GetData()};
+    float* RESTRICT UNext{Next.GetData()};
+
+    // Interior nodes only, the ends stay fixed at zero
+    const int32 LastInterior{NumNodes - 2};
+    int32 Node{1};
+    for (; Node + 3 <= LastInterior; Node += 4)
+    {
+        const VectorRegister4Float Neighbours = VectorAdd(VectorLoad(U + Node - 1), VectorLoad(U + Node + 1));
+        VectorRegister4Float Result = VectorMultiply(VectorLoad(U + Node), CenterScaleV);
+        Result = VectorMultiplyAdd(Neighbours, NeighbourScaleV, Result);
+        Result = VectorMultiplyAdd(VectorLoad(UPrevious + Node), PreviousScaleV, Result);
+        VectorStore(Result, UNext + Node);
+    }
+
+    for (; Node <= LastInterior; ++Node)
+    {
+        UNext[Node] = U[Node] * CenterScale + (U[Node - 1] + U[Node + 1]) * NeighbourScale + UPrevious[Node] * PreviousScale;
+    }
+
+    UNext[0] = 0.0f;
+    UNext[NumNodes - 1] = 0.0f;
+
+    // Rotate the buffers without copying: previous <- current <- next, the old previous becomes scratch
+    Swap(Previous, Current);
+    Swap(Current, Next);
+}
+
+void FStringWaveSolver::FindCrests(const float Time)
+{
+    const float NodeDelta{1.0f / static_cast<float>(NumNodes - 1)};
+
+    // After a step, Next still holds the step before Previous, so Previous is at a crest where it is further out than both of its neighbours in time.
+    // A crest between two steps lands on two equal samples, ties in time are resolved to the first of them.
+    for (int32 Node = 1; Node < NumNodes - 1 && Crests.Num() < Crests.Max(); ++Node)
+    {
+        const float Magnitude{FMath::Abs(Previous[Node])};
+        if (Magnitude < CrestThreshold || Magnitude <= FMath::Abs(Next[Node]) || Magnitude < FMath::Abs(Current[Node])) { continue; }
+
+        // Same peaks of the shape as FindPeaks
+        if (Magnitude < FMath::Abs(Previous[Node - 1]) || Magnitude <= FMath::Abs(Previous[Node + 1])) { continue; }
+
+        // On a fine string the top of a peak is flat enough for rounding to crest it at a neighbouring node a step apart, only the furthest out counts
+        if (Magnitude <= FMath::Abs(Next[Node - 1]) || Magnitude <= FMath::Abs(Next[Node + 1])
+            || Magnitude < FMath::Abs(Current[Node - 1]) || Magnitude < FMath::Abs(Current[Node + 1])) { continue; }
+
+        // Age holds the time into the Advance until it ends
+        Crests.Add({{static_cast<float>(Node) * NodeDelta, Previous[Node]}, Time});
+    }
+}
+
+// Advances many strings for a number of 60 Hz frames and reports the average cost per frame
+static FAutoConsoleCommand BenchmarkStringSolverCommand(
+    TEXT("Archons.String.BenchmarkSolver"),
+    TEXT("Archons.String.BenchmarkSolver [Strings=64] [Nodes=256] [Frames=600]"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+    {
+        const int32 NumStrings{FMath::Max(Args.IsValidIndex(0) ? FCString::Atoi(*Args[0]) : 64, 1)};
+        const int32 NumNodes{FMath::Max(Args.IsValidIndex(1) ? FCString::Atoi(*Args[1]) : 256, 3)};
+        const int32 NumFrames{FMath::Max(Args.IsValidIndex(2) ? FCString::Atoi(*Args[2]) : 600, 1)};
+
+        constexpr float TimeStep = 1.0f / 480.0f;
+        constexpr float FrameTime = 1.0f / 60.0f;
+        constexpr double BudgetMs = 0.5;
+
+        TArray<FStringWaveSolver> Solvers;
+        Solvers.SetNum(NumStrings);
+        for (int32 Index = 0; Index < NumStrings; ++Index)
+        {
+            Solvers[Index].Initialize(NumNodes, TimeStep);
+            Solvers[Index].SetWaveSpeed(0.5f);
+            Solvers[Index].SetDamping(0.1f);
+            Solvers[Index].Pluck(2 + Index % 4, 1.0f);
+            Solvers[Index].Pluck(3 + Index % 3, 0.5f);
+        }
+
+        TArray<FStringWavePeak> Peaks;
+        Peaks.Reserve(NumNodes);
+
+        const double StartTime{FPlatformTime::Seconds()};
+        for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+        {
+            for (FStringWaveSolver& Solver : Solvers)
+            {
+                Solver.Advance(FrameTime);
+                Solver.FindPeaks(0.1f, Peaks);
+            }
+        }
+        const double FrameMs{(FPlatformTime::Seconds() - StartTime) * 1000.0 / NumFrames};
+
+        UE_LOG(LogTemp, Display, TEXT("%i strings, %i nodes: %.3f ms per frame (budget %.2f ms, %s)"),
+            NumStrings, NumNodes, FrameMs, BudgetMs, FrameMs <= BudgetMs ? TEXT("within budget") : TEXT("over budget"));
+    }));
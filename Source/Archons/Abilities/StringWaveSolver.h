@@ -0,0 +1,72 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FStringWavePeak
+{
+    // Position along the string, 0 at the first end and 1 at the second
+    float Position;
+    float Displacement;
+};
+
+struct FStringWaveCrest
+{
+    FStringWavePeak Peak;
+
+    // Seconds from the crest until the end of the Advance that found it
+    float Age;
+};
+
+/**
+ * Damped wave equation on a string with fixed ends, discretized over evenly spaced nodes on a normalized length of 1.
+ * Integrated with a fixed time step using central differences, four nodes at a time. All buffers are allocated in Initialize,
+ * stepping never allocates. Fine strings or fast waves split every step into substeps to keep the scheme stable, so the wave keeps its speed at any node count.
+ *
+ * Budget: 64 strings of 256 nodes stepped at 480 Hz within 0.5 ms per 60 Hz frame, checked by Archons.String.BenchmarkSolver.
+ */
+class ARCHONS_API FStringWaveSolver
+{
+public:
+    void Initialize(const int32 InNumNodes, const float InTimeStep);
+    void Reset();
+
+    // Wave speed in string lengths per second, and damping in 1/s
+    void SetWaveSpeed(const float InWaveSpeed);
+    void SetDamping(const float InDamping);
+
+    // Crests are peaks of the shape at their furthest out in time, reported by Advance once they reach this displacement. 0 disables them.
+    void SetCrestThreshold(const float InCrestThreshold);
+
+    // Adds a standing wave of the given harmonic at its maximum, so plucks superpose with whatever is already ringing
+    void Pluck(const int32 Harmonic, const float Amplitude);
+
+    // Runs as many fixed steps as fit in the accumulated time
+    void Advance(const float DeltaTime);
+
+    float Sample(const float Position) const;
+    void FindPeaks(const float MinDisplacement, TArray<FStringWavePeak>& OutPeaks) const;
+
+    // Crests found by the last Advance, oldest first
+    const TArray<FStringWaveCrest>& GetCrests() const;
+
+    int32 GetNumNodes() const;
+
+private:
+    int32 NumNodes = 0;
+    float TimeStep = 0.0f;
+    float WaveSpeed = 1.0f;
+    float Damping = 0.0f;
+    float Accumulator = 0.0f;
+    float CrestThreshold = 0.0f;
+
+    TArray<float> Previous;
+    TArray<float> Current;
+    TArray<float> Next;
+    TArray<FStringWaveCrest> Crests;
+
+    int32 GetNumSubsteps() const;
+    void Step(const float StepTime);
+    void FindCrests(const float Time);
+};
@@ -15,5 +15,8 @@ public class Archons : ModuleRules
 
         // Navigation
         PrivateDependencyModuleNames.AddRange(new string[] { "NavigationSystem" });
+
+        // Networking
+        PrivateDependencyModuleNames.AddRange(new string[] { "ReplicationGraph" });
     }
 }
\ No newline at end of file
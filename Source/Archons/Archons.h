@@ -3,3 +3,29 @@
 #pragma once
 
 #include "CoreMinimal.h"
+
+DECLARE_STATS_GROUP(TEXT("Archons"), STATGROUP_Archons, STATCAT_Advanced);
+
+/**
+ * UE_LOG to LogTemp that prints at most once per MinInterval seconds for each call site, counting what it skipped in between.
+ * For warnings that can fire many times per frame, where the logging itself would cost more than the problem it reports.
+ * Game thread only.
+ */
+#define ARCHONS_LOG_RATE_LIMITED(MinInterval, Verbosity, Format, ...) \
+    do \
+    { \
+        static double ArchonsLastLogTime = -MAX_dbl; \
+        static int32 ArchonsNumSuppressed = 0; \
+        const double ArchonsLogTime = FPlatformTime::Seconds(); \
+        if (ArchonsLogTime - ArchonsLastLogTime >= (MinInterval)) \
+        { \
+            const FString ArchonsSuppressedSuffix = ArchonsNumSuppressed > 0 ? FString::Printf(TEXT(" (%i similar messages suppressed)"), ArchonsNumSuppressed) : FString(); \
+            UE_LOG(LogTemp, Verbosity, Format TEXT("%s"), ##__VA_ARGS__, *ArchonsSuppressedSuffix); \
+            ArchonsLastLogTime = ArchonsLogTime; \
+            ArchonsNumSuppressed = 0; \
+        } \
+        else \
+        { \
+            ++ArchonsNumSuppressed; \
+        } \
+    } while (false)
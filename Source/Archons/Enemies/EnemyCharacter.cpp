@@ -2,12 +2,14 @@
 
 #include "EnemyCharacter.h"
 
+#include "Archons/Game/HitchWatchdogSubsystem.h"
 #include "Archons/Player/MainPlayerController.h"
+#include "GameFramework/PawnMovementComponent.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Runtime/AIModule/Classes/AIController.h"
 
-AEnemyCharacter::AEnemyCharacter()
+AEnemyCharacter::AEnemyCharacter(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
 {
     PrimaryActorTick.bCanEverTick = false;
 
@@ -36,9 +38,22 @@ void AEnemyCharacter::BeginPlay()
 
     OnTakeAnyDamage.AddDynamic(this, &AEnemyCharacter::HandleTakeAnyDamage);
 
+    UHitchWatchdogSubsystem::AdjustEnemiesAlive(1);
+
     OnSpawn();
 }
 
+void AEnemyCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    // Dead enemies were already taken off the count when they died
+    if (!IsDead())
+    {
+        UHitchWatchdogSubsystem::AdjustEnemiesAlive(-1);
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
 void AEnemyCharacter::PossessedBy(AController* NewController)
 {
     Super::PossessedBy(NewController);
@@ -47,6 +62,28 @@ void AEnemyCharacter::PossessedBy(AController* NewController)
     ensureAlways(AIControllerRef);
 }
 
+void AEnemyCharacter::RestoreState(const FTransform& Transform, const float InHealth, ACharacter* Target)
+{
+    if (IsValid(AIControllerRef))
+    {
+        AIControllerRef->StopMovement();
+    }
+
+    if (UPawnMovementComponent* PawnMovementComponent{GetMovementComponent()})
+    {
+        PawnMovementComponent->StopMovementImmediately();
+    }
+
+    SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+
+    Health = InHealth;
+    CurrentTarget = Target;
+
+    // Head for the captured target right away, picking a closer one only on the regular interval
+    MoveToCurrentTarget();
+    GetWorldTimerManager().SetTimer(TargetTimerHandle, this, &AEnemyCharacter::PickTarget, 0.5f, true);
+}
+
 void AEnemyCharacter::OnSpawnAnimationComplete()
 {
     GetWorldTimerManager().SetTimer(TargetTimerHandle, this, &AEnemyCharacter::PickTarget, 0.5f, true, 0.0f);
@@ -77,15 +114,26 @@ void AEnemyCharacter::PickTarget()
 
     CurrentTarget = (DistanceA < DistanceB) ? CharacterA : CharacterB;
 
-    if (!IsValid(AIControllerRef)) { return; }
+    MoveToCurrentTarget();
+}
+
+void AEnemyCharacter::MoveToCurrentTarget()
+{
+    if (!IsValid(AIControllerRef) || !CurrentTarget.IsValid()) { return; }
 
-    AIControllerRef->MoveToActor(CurrentTarget.Get());
+    if (AIControllerRef->MoveToActor(CurrentTarget.Get()) == EPathFollowingRequestResult::Failed)
+    {
+        // The navmesh around the target may still be building, head straight for it until a path can be found
+        AIControllerRef->MoveToActor(CurrentTarget.Get(), -1.0f, true, false);
+    }
 }
 
 void AEnemyCharacter::HandleTakeAnyDamage(AActor* DamagedActor, float Damage, const UDamageType* DamageType, AController* InstigatedBy, AActor* DamageCauser)
 {
     if (Damage <= 0.0f || Health <= 0.0f) { return; }
 
+    UHitchWatchdogSubsystem::Count(EHitchWatchdogCounter::DamageEvents);
+
     if (IsValid(AIControllerRef))
     {
         AIControllerRef->StopMovement();
@@ -101,6 +149,31 @@ void AEnemyCharacter::HandleTakeAnyDamage(AActor* DamagedActor, float Damage, co
     {
         Health = 0.0f;
         GetWorldTimerManager().ClearTimer(TargetTimerHandle);
+
+        // Nothing about a dying enemy changes anymore. Its channels still send this final state before going dormant until it is destroyed.
+        SetNetDormancy(DORM_DormantAll);
+        UHitchWatchdogSubsystem::AdjustEnemiesAlive(-1);
+
         OnDeath();
     }
 }
+
+float AEnemyCharacter::GetHealth() const
+{
+    return Health;
+}
+
+bool AEnemyCharacter::IsDead() const
+{
+    return Health <= 0.0f;
+}
+
+bool AEnemyCharacter::IsTargetTimerActive() const
+{
+    return GetWorldTimerManager().TimerExists(TargetTimerHandle);
+}
+
+ACharacter* AEnemyCharacter::GetCurrentTarget() const
+{
+    return CurrentTarget.Get();
+}
@@ -27,14 +27,18 @@ class ARCHONS_API AEnemyCharacter : public ACharacter
     float Health;
 
 public:
-    AEnemyCharacter();
+    AEnemyCharacter(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
     virtual void PossessedBy(AController* NewController) override;
 
     FEnemyCharacterDiedDelegate CharacterDiedDelegate;
 
+    // Teleports a living enemy into a captured state and resumes chasing, skipping the spawn animation
+    void RestoreState(const FTransform& Transform, const float InHealth, ACharacter* Target);
+
 protected:
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
     UFUNCTION(BlueprintImplementableEvent)
     void OnSpawn();
@@ -62,4 +66,12 @@ private:
     TWeakObjectPtr<ACharacter> CurrentTarget;
 
     void PickTarget();
+    void MoveToCurrentTarget();
+
+public:
+    /** Getters and Setters */
+    float GetHealth() const;
+    bool IsDead() const;
+    bool IsTargetTimerActive() const;
+    ACharacter* GetCurrentTarget() const;
 };
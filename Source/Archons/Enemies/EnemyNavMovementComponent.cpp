@@ -0,0 +1,377 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "EnemyNavMovementComponent.h"
+
+#include "EngineUtils.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "Archons/Archons.h"
+#include "Archons/Enemies/EnemyCharacter.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Misc/ScopeExit.h"
+#include "Serialization/ArchiveCountMem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Enemy Nav Movement Tick"), STAT_EnemyNavMovementTick, STATGROUP_Archons);
+DECLARE_CYCLE_STAT(TEXT("Enemy Separation Rebuild"), STAT_EnemySeparationRebuild, STATGROUP_Archons);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemies Nav Walking"), STAT_EnemiesNavWalking, STATGROUP_Archons);
+DECLARE_MEMORY_STAT(TEXT("Enemy Separation Hash"), STAT_EnemySeparationHashMemory, STATGROUP_Archons);
+
+UEnemyNavMovementComponent::UEnemyNavMovementComponent()
+{
+    PrimaryComponentTick.bCanEverTick = true;
+    PrimaryComponentTick.TickGroup = TG_PrePhysics;
+
+    MaxSpeed = 300.0f;
+    RotationRate = 540.0f;
+    bOrientRotationToMovement = true;
+
+    ProjectionExtent = FVector(25.0, 25.0, 150.0);
+
+    SeparationRadius = 100.0f;
+    SeparationStrength = 0.5f;
+
+    RequestedVelocity = FVector::ZeroVector;
+
+    NavAgentProps.bCanWalk = true;
+    bUseAccelerationForPaths = false;
+}
+
+void UEnemyNavMovementComponent::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (UEnemyNavMovementSubsystem* Subsystem{GetWorld()->GetSubsystem<UEnemyNavMovementSubsystem>()})
+    {
+        Subsystem->RegisterComponent(this);
+    }
+}
+
+void UEnemyNavMovementComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (UEnemyNavMovementSubsystem* Subsystem{GetWorld()->GetSubsystem<UEnemyNavMovementSubsystem>()})
+    {
+        Subsystem->UnregisterComponent(this);
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void UEnemyNavMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    SCOPE_CYCLE_COUNTER(STAT_EnemyNavMovementTick);
+    INC_DWORD_STAT(STAT_EnemiesNavWalking);
+
+    UEnemyNavMovementSubsystem* Subsystem{GetWorld()->GetSubsystem<UEnemyNavMovementSubsystem>()};
+    const uint64 StartCycles{FPlatformTime::Cycles64()};
+    ON_SCOPE_EXIT
+    {
+        if (Subsystem)
+        {
+            Subsystem->AddTickCycles(FPlatformTime::Cycles64() - StartCycles);
+        }
+    };
+
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    if (ShouldSkipUpdate(DeltaTime) || !IsValid(PawnOwner) || !UpdatedComponent) { return; }
+
+    // Path following either requests a velocity directly or feeds the input vector, depending on bUseAccelerationForPaths
+    const FVector InputVector{ConsumeInputVector()};
+    FVector DesiredVelocity{InputVector.IsNearlyZero() ? RequestedVelocity : InputVector.GetClampedToMaxSize(1.0) * MaxSpeed};
+
+    if (!DesiredVelocity.IsNearlyZero())
+    {
+        DesiredVelocity += GetSeparationVelocity();
+    }
+
+    DesiredVelocity.Z = 0.0;
+    Velocity = DesiredVelocity.GetClampedToMaxSize(MaxSpeed);
+
+    if (Velocity.IsNearlyZero())
+    {
+        UpdateComponentVelocity();
+        return;
+    }
+
+    const FVector FeetLocation{GetActorFeetLocation()};
+    const FVector FeetOffset{UpdatedComponent->GetComponentLocation() - FeetLocation};
+    FVector NewFeetLocation{FeetLocation + Velocity * DeltaTime};
+
+    // Stay on the navmesh instead of sweeping for floors: snap onto the polygon below, or stop at the navmesh border
+    if (const ANavigationData* NavigationData{GetNavigationData()})
+    {
+        FNavLocation ProjectedLocation;
+        if (NavigationData->ProjectPoint(NewFeetLocation, ProjectedLocation, ProjectionExtent, nullptr, PawnOwner))
+        {
+            NewFeetLocation = ProjectedLocation.Location;
+        }
+        else
+        {
+            NewFeetLocation = FeetLocation;
+            Velocity = FVector::ZeroVector;
+        }
+    }
+
+    UpdatedComponent->SetWorldLocation(NewFeetLocation + FeetOffset, false, nullptr, ETeleportType::None);
+    RotateTowardsMovement(DeltaTime);
+
+    UpdateComponentVelocity();
+}
+
+float UEnemyNavMovementComponent::GetMaxSpeed() const
+{
+    return MaxSpeed;
+}
+
+void UEnemyNavMovementComponent::StopMovementImmediately()
+{
+    Super::StopMovementImmediately();
+
+    RequestedVelocity = FVector::ZeroVector;
+}
+
+void UEnemyNavMovementComponent::RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed)
+{
+    RequestedVelocity = bForceMaxSpeed ? MoveVelocity.GetSafeNormal() * MaxSpeed : MoveVelocity.GetClampedToMaxSize(MaxSpeed);
+}
+
+bool UEnemyNavMovementComponent::CanStartPathFollowing() const
+{
+    return IsValid(PawnOwner) && UpdatedComponent != nullptr;
+}
+
+const ANavigationData* UEnemyNavMovementComponent::GetNavigationData()
+{
+    if (!NavigationDataRef.IsValid())
+    {
+        if (const UNavigationSystemV1* NavigationSystem{FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld())})
+        {
+            NavigationDataRef = NavigationSystem->GetNavDataForProps(GetNavAgentPropertiesRef(), GetActorFeetLocation());
+        }
+    }
+
+    return NavigationDataRef.Get();
+}
+
+FVector UEnemyNavMovementComponent::GetSeparationVelocity() const
+{
+    if (SeparationRadius <= 0.0f || SeparationStrength <= 0.0f) { return FVector::ZeroVector; }
+
+    UEnemyNavMovementSubsystem* Subsystem{GetWorld()->GetSubsystem<UEnemyNavMovementSubsystem>()};
+    if (!Subsystem) { return FVector::ZeroVector; }
+
+    const FVector Location{UpdatedComponent->GetComponentLocation()};
+    const double RadiusSquared{FMath::Square(static_cast<double>(SeparationRadius))};
+
+    // Push away from every neighbour, stronger the closer it is
+    FVector Separation{FVector::ZeroVector};
+    Subsystem->ForEachNeighbour(this, Location, SeparationRadius, [&](const FVector& NeighbourLocation)
+    {
+        const FVector Offset{(Location - NeighbourLocation) * FVector(1.0, 1.0, 0.0)};
+        const double DistanceSquared{Offset.SizeSquared()};
+
+        if (DistanceSquared >= RadiusSquared) { return; }
+
+        if (DistanceSquared < UE_KINDA_SMALL_NUMBER)
+        {
+            // Fully overlapping neighbours push apart in a stable direction derived from the unique id
+            Separation += FVector(1.0, 0.0, 0.0).RotateAngleAxis(static_cast<double>(GetUniqueID() % 360), FVector::ZAxisVector);
+            return;
+        }
+
+        const double Distance{FMath::Sqrt(DistanceSquared)};
+        Separation += Offset / Distance * (1.0 - Distance / SeparationRadius);
+    });
+
+    return Separation.GetClampedToMaxSize(1.0) * MaxSpeed * SeparationStrength;
+}
+
+void UEnemyNavMovementComponent::RotateTowardsMovement(const float DeltaTime)
+{
+    if (!bOrientRotationToMovement || Velocity.IsNearlyZero()) { return; }
+
+    const FRotator CurrentRotation{UpdatedComponent->GetComponentRotation()};
+    FRotator TargetRotation{CurrentRotation};
+    TargetRotation.Yaw = Velocity.Rotation().Yaw;
+
+    const FRotator NewRotation{FMath::RInterpConstantTo(CurrentRotation, TargetRotation, DeltaTime, RotationRate)};
+    UpdatedComponent->SetWorldRotation(NewRotation);
+}
+
+void UEnemyNavMovementSubsystem::RegisterComponent(UEnemyNavMovementComponent* Component)
+{
+    Components.AddUnique(Component);
+    LastRebuildFrame = MAX_uint64;
+}
+
+void UEnemyNavMovementSubsystem::UnregisterComponent(UEnemyNavMovementComponent* Component)
+{
+    Components.RemoveSwap(Component);
+    LastRebuildFrame = MAX_uint64;
+}
+
+void UEnemyNavMovementSubsystem::ForEachNeighbour(const UEnemyNavMovementComponent* Self, const FVector& Location, const float Radius, TFunctionRef<void(const FVector& NeighbourLocation)> Visitor)
+{
+    RebuildIfNeeded(Radius);
+
+    if (CellSize <= 0.0f) { return; }
+
+    const int32 CellRange{FMath::CeilToInt32(Radius / CellSize)};
+    const FIntPoint CenterCell{GetCell(Location)};
+
+    for (int32 X = CenterCell.X - CellRange; X <= CenterCell.X + CellRange; ++X)
+    {
+        for (int32 Y = CenterCell.Y - CellRange; Y <= CenterCell.Y + CellRange; ++Y)
+        {
+            const uint64 CellKey{GetCellKey(FIntPoint(X, Y))};
+            int32 EntryIndex{static_cast<int32>(Algo::LowerBoundBy(CellEntries, CellKey, [](const TPair<uint64, int32>& Entry) { return Entry.Key; }))};
+
+            for (; EntryIndex < CellEntries.Num() && CellEntries[EntryIndex].Key == CellKey; ++EntryIndex)
+            {
+                const int32 ComponentIndex{CellEntries[EntryIndex].Value};
+                if (Components[ComponentIndex] == Self) { continue; }
+
+                Visitor(CachedLocations[ComponentIndex]);
+            }
+        }
+    }
+}
+
+int32 UEnemyNavMovementSubsystem::GetNumComponents() const
+{
+    return Components.Num();
+}
+
+SIZE_T UEnemyNavMovementSubsystem::GetAllocatedSize() const
+{
+    return Components.GetAllocatedSize() + CellEntries.GetAllocatedSize() + CachedLocations.GetAllocatedSize();
+}
+
+void UEnemyNavMovementSubsystem::AddTickCycles(const uint64 Cycles)
+{
+    TickCycles += Cycles;
+    ++NumTicks;
+}
+
+void UEnemyNavMovementSubsystem::ResetTickCycles()
+{
+    TickCycles = 0;
+    NumTicks = 0;
+    TickCyclesStartFrame = GFrameCounter;
+}
+
+uint64 UEnemyNavMovementSubsystem::GetTickCycles() const
+{
+    return TickCycles;
+}
+
+int32 UEnemyNavMovementSubsystem::GetNumTicks() const
+{
+    return NumTicks;
+}
+
+uint64 UEnemyNavMovementSubsystem::GetNumTickFrames() const
+{
+    return GFrameCounter - TickCyclesStartFrame;
+}
+
+void UEnemyNavMovementSubsystem::RebuildIfNeeded(const float Radius)
+{
+    if (LastRebuildFrame == GFrameCounter) { return; }
+
+    SCOPE_CYCLE_COUNTER(STAT_EnemySeparationRebuild);
+
+    LastRebuildFrame = GFrameCounter;
+    CellSize = Radius;
+
+    // Locations are cached once per frame, so every enemy separates from the same snapshot regardless of tick order
+    CachedLocations.Reset(Components.Num());
+    CellEntries.Reset(Components.Num());
+
+    for (int32 Index = 0; Index < Components.Num(); ++Index)
+    {
+        const USceneComponent* UpdatedComponent{Components[Index] ? Components[Index]->UpdatedComponent : nullptr};
+        const FVector Location{UpdatedComponent ? UpdatedComponent->GetComponentLocation() : FVector::ZeroVector};
+
+        CachedLocations.Add(Location);
+
+        if (UpdatedComponent)
+        {
+            CellEntries.Emplace(GetCellKey(GetCell(Location)), Index);
+        }
+    }
+
+    Algo::SortBy(CellEntries, [](const TPair<uint64, int32>& Entry) { return Entry.Key; });
+
+    SET_MEMORY_STAT(STAT_EnemySeparationHashMemory, GetAllocatedSize());
+}
+
+FIntPoint UEnemyNavMovementSubsystem::GetCell(const FVector& Location) const
+{
+    return FIntPoint(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize));
+}
+
+uint64 UEnemyNavMovementSubsystem::GetCellKey(const FIntPoint& Cell)
+{
+    return (static_cast<uint64>(static_cast<uint32>(Cell.X)) << 32) | static_cast<uint64>(static_cast<uint32>(Cell.Y));
+}
+
+// Compares the per-instance footprint of the movement components used by the enemies currently in the world, counting everything
+// they allocate and, for UEnemyNavMovementComponent, their share of the separation hash. CPU time is reported by "stat Archons" for
+// UEnemyNavMovementComponent and by "stat Character" for UCharacterMovementComponent, this also logs the former since the last call.
+static FAutoConsoleCommandWithWorld DumpEnemyMovementFootprintCommand(
+    TEXT("Archons.Enemies.DumpMovementFootprint"),
+    TEXT("Logs the number of enemies, the per-instance memory of their movement components and the nav movement tick time since the last call"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        if (!World) { return; }
+
+        TMap<const UClass*, TPair<int32, SIZE_T>> FootprintByClass;
+        for (TActorIterator<AEnemyCharacter> It(World); It; ++It)
+        {
+            UPawnMovementComponent* MovementComponent{It->GetMovementComponent()};
+            if (!MovementComponent) { continue; }
+
+            // Counts the instance itself and every container it serializes at their allocated size
+            FArchiveCountMem CountMem(MovementComponent);
+
+            TPair<int32, SIZE_T>& Footprint{FootprintByClass.FindOrAdd(MovementComponent->GetClass())};
+            Footprint.Key += 1;
+            Footprint.Value += CountMem.GetMax() + MovementComponent->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+        }
+
+        UE_LOG(LogTemp, Display, TEXT("Instance size: %s = %i bytes, %s = %i bytes"),
+            *UCharacterMovementComponent::StaticClass()->GetName(), UCharacterMovementComponent::StaticClass()->GetStructureSize(),
+            *UEnemyNavMovementComponent::StaticClass()->GetName(), UEnemyNavMovementComponent::StaticClass()->GetStructureSize());
+
+        UEnemyNavMovementSubsystem* Subsystem{World->GetSubsystem<UEnemyNavMovementSubsystem>()};
+        const SIZE_T SeparationHashSize{Subsystem ? Subsystem->GetAllocatedSize() : 0};
+
+        for (TPair<const UClass*, TPair<int32, SIZE_T>>& Entry : FootprintByClass)
+        {
+            if (Entry.Key->IsChildOf<UEnemyNavMovementComponent>())
+            {
+                Entry.Value.Value += SeparationHashSize;
+            }
+
+            UE_LOG(LogTemp, Display, TEXT("%s: %i enemies, %llu bytes total, %llu bytes per enemy"),
+                *Entry.Key->GetName(), Entry.Value.Key, static_cast<uint64>(Entry.Value.Value), static_cast<uint64>(Entry.Value.Value / Entry.Value.Key));
+        }
+
+        if (Subsystem && Subsystem->GetNumTicks() > 0)
+        {
+            const double TickMs{FPlatformTime::ToMilliseconds64(Subsystem->GetTickCycles())};
+            const uint64 NumFrames{FMath::Max(Subsystem->GetNumTickFrames(), static_cast<uint64>(1))};
+
+            UE_LOG(LogTemp, Display, TEXT("%s: separation hash %llu bytes, ticks took %.3f ms per frame and %.2f us per tick over %llu frames"),
+                *UEnemyNavMovementComponent::StaticClass()->GetName(), static_cast<uint64>(SeparationHashSize),
+                TickMs / static_cast<double>(NumFrames), TickMs * 1000.0 / static_cast<double>(Subsystem->GetNumTicks()), NumFrames);
+        }
+
+        if (Subsystem)
+        {
+            Subsystem->ResetTickCycles();
+        }
+    }));
@@ -0,0 +1,111 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "EnemyNavMovementComponent.generated.h"
+
+class ANavigationData;
+class UEnemyNavMovementComponent;
+
+/**
+ * Lightweight alternative to UCharacterMovementComponent for enemies that only need to walk on the navmesh.
+ * Instead of floor sweeps and physics modes, the updated component is moved without collision and snapped onto the
+ * navmesh polygon below it. Enemies keep apart from each other through a simple separation force.
+ */
+UCLASS(ClassGroup=(Movement), meta=(BlueprintSpawnableComponent))
+class ARCHONS_API UEnemyNavMovementComponent : public UPawnMovementComponent
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, meta=(ClampMin=0.0f))
+    float MaxSpeed;
+
+    UPROPERTY(EditAnywhere, meta=(ClampMin=0.0f))
+    float RotationRate;
+
+    UPROPERTY(EditAnywhere, DisplayName="Orient Rotation To Movement?")
+    bool bOrientRotationToMovement;
+
+    // Vertical extent is how far above or below the feet the navmesh can be found
+    UPROPERTY(EditAnywhere)
+    FVector ProjectionExtent;
+
+    UPROPERTY(EditAnywhere, meta=(ClampMin=0.0f))
+    float SeparationRadius;
+
+    UPROPERTY(EditAnywhere, meta=(ClampMin=0.0f, ClampMax=1.0f))
+    float SeparationStrength;
+
+public:
+    UEnemyNavMovementComponent();
+
+protected:
+    virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+    virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+    /** UMovementComponent */
+    virtual float GetMaxSpeed() const override;
+    virtual void StopMovementImmediately() override;
+
+    /** UNavMovementComponent */
+    virtual void RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed) override;
+    virtual bool CanStartPathFollowing() const override;
+
+private:
+    FVector RequestedVelocity;
+    TWeakObjectPtr<const ANavigationData> NavigationDataRef;
+
+    const ANavigationData* GetNavigationData();
+    FVector GetSeparationVelocity() const;
+    void RotateTowardsMovement(const float DeltaTime);
+};
+
+/** Spatial hash of every enemy walking with UEnemyNavMovementComponent, rebuilt at most once per frame for separation queries */
+UCLASS()
+class ARCHONS_API UEnemyNavMovementSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    void RegisterComponent(UEnemyNavMovementComponent* Component);
+    void UnregisterComponent(UEnemyNavMovementComponent* Component);
+
+    // Calls Visitor for every registered component within Radius of Location (in the XY plane), excluding Self
+    void ForEachNeighbour(const UEnemyNavMovementComponent* Self, const FVector& Location, const float Radius, TFunctionRef<void(const FVector& NeighbourLocation)> Visitor);
+
+    int32 GetNumComponents() const;
+
+    // Bytes allocated for the registered components and the spatial hash
+    SIZE_T GetAllocatedSize() const;
+
+    // Movement ticks report their time here, Archons.Enemies.DumpMovementFootprint logs and resets it
+    void AddTickCycles(const uint64 Cycles);
+    void ResetTickCycles();
+    uint64 GetTickCycles() const;
+    int32 GetNumTicks() const;
+    uint64 GetNumTickFrames() const;
+
+private:
+    UPROPERTY()
+    TArray<UEnemyNavMovementComponent*> Components;
+
+    // Sorted by cell key, so that all entries of a cell are contiguous
+    TArray<TPair<uint64, int32>> CellEntries;
+    TArray<FVector> CachedLocations;
+    float CellSize = 0.0f;
+    uint64 LastRebuildFrame = MAX_uint64;
+
+    uint64 TickCycles = 0;
+    int32 NumTicks = 0;
+    uint64 TickCyclesStartFrame = 0;
+
+    void RebuildIfNeeded(const float Radius);
+    FIntPoint GetCell(const FVector& Location) const;
+    static uint64 GetCellKey(const FIntPoint& Cell);
+};
@@ -0,0 +1,16 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "NavWalkingEnemyCharacter.h"
+
+#include "EnemyNavMovementComponent.h"
+#include "Components/CapsuleComponent.h"
+
+ANavWalkingEnemyCharacter::ANavWalkingEnemyCharacter(const FObjectInitializer& ObjectInitializer)
+    : Super(ObjectInitializer.DoNotCreateDefaultSubobject(ACharacter::CharacterMovementComponentName))
+{
+    // Rotation comes from the movement direction, not from the AI controller's focus
+    bUseControllerRotationYaw = false;
+
+    NavMovementComponent = CreateDefaultSubobject<UEnemyNavMovementComponent>(TEXT("NavMovement"));
+    NavMovementComponent->UpdatedComponent = GetCapsuleComponent();
+}
@@ -0,0 +1,27 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EnemyCharacter.h"
+#include "NavWalkingEnemyCharacter.generated.h"
+
+class UEnemyNavMovementComponent;
+
+/**
+ * Enemy that walks with UEnemyNavMovementComponent instead of UCharacterMovementComponent.
+ * Reparent an enemy blueprint to this class to trade collision-accurate movement for a much smaller per-enemy cost.
+ * GetCharacterMovement() returns nullptr for this class, so animation blueprints should read GetVelocity() instead.
+ */
+UCLASS()
+class ARCHONS_API ANavWalkingEnemyCharacter : public AEnemyCharacter
+{
+    GENERATED_BODY()
+
+protected:
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+    UEnemyNavMovementComponent* NavMovementComponent;
+
+public:
+    ANavWalkingEnemyCharacter(const FObjectInitializer& ObjectInitializer);
+};
@@ -0,0 +1,255 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "ArchonsReplicationGraph.h"
+
+#include "Archons/Archons.h"
+#include "Archons/Enemies/EnemyCharacter.h"
+#include "Archons/Interfaces/SpanAbilityOwner.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "UObject/UObjectIterator.h"
+
+DECLARE_CYCLE_STAT(TEXT("Enemy Grid Prepare"), STAT_ArchonsEnemyGridPrepare, STATGROUP_Archons);
+DECLARE_CYCLE_STAT(TEXT("Enemy Grid Gather"), STAT_ArchonsEnemyGridGather, STATGROUP_Archons);
+
+static TAutoConsoleVariable<float> CVarNetEnemyCellSize(
+    TEXT("Archons.Net.EnemyCellSize"), 2000.0f,
+    TEXT("Size of an enemy grid cell in centimeters"));
+
+static TAutoConsoleVariable<int32> CVarNetEnemyNearCells(
+    TEXT("Archons.Net.EnemyNearCells"), 2,
+    TEXT("Enemies within this many cells of a character are replicated every frame"));
+
+static TAutoConsoleVariable<int32> CVarNetEnemyFarCells(
+    TEXT("Archons.Net.EnemyFarCells"), 5,
+    TEXT("Enemies within this many cells of a character are replicated at reduced frequency, further ones are culled"));
+
+static TAutoConsoleVariable<int32> CVarNetEnemyFarFrameStride(
+    TEXT("Archons.Net.EnemyFarFrameStride"), 4,
+    TEXT("Far enemies are replicated every this many replication frames. Read when the replication graph is created"));
+
+static FAutoConsoleCommandWithWorld NetReportCommand(
+    TEXT("Archons.Net.Report"),
+    TEXT("Logs bandwidth and open channels for each client connection, and the enemy grid state"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        const UNetDriver* NetDriver{World ? World->GetNetDriver() : nullptr};
+        if (!NetDriver || !NetDriver->IsServer())
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Archons.Net.Report only works on a server."));
+            return;
+        }
+
+        int32 TotalOutBytesPerSecond{0};
+        for (const UNetConnection* Connection : NetDriver->ClientConnections)
+        {
+            if (!Connection) { continue; }
+
+            UE_LOG(LogTemp, Display, TEXT("%s: out %i B/s, in %i B/s, %i open channels"),
+                *Connection->LowLevelGetRemoteAddress(true), Connection->OutBytesPerSecond, Connection->InBytesPerSecond, Connection->OpenChannels.Num());
+
+            TotalOutBytesPerSecond += Connection->OutBytesPerSecond;
+        }
+
+        UE_LOG(LogTemp, Display, TEXT("%i connections, out %i B/s in total"), NetDriver->ClientConnections.Num(), TotalOutBytesPerSecond);
+
+        if (const UArchonsReplicationGraph* ReplicationGraph{Cast<UArchonsReplicationGraph>(NetDriver->GetReplicationDriver())})
+        {
+            if (const UArchonsReplicationGraphNode_EnemyGrid* EnemyGridNode{ReplicationGraph->GetEnemyGridNode()})
+            {
+                UE_LOG(LogTemp, Display, TEXT("Enemy grid: %i enemies, %i awake, %i cells"),
+                    EnemyGridNode->GetNumEnemies(), EnemyGridNode->GetNumAwakeEnemies(), EnemyGridNode->GetNumCells());
+            }
+        }
+    }));
+
+namespace
+{
+    FIntPoint GetCell(const FVector& Location, const float CellSize)
+    {
+        return FIntPoint(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize));
+    }
+}
+
+UArchonsReplicationGraphNode_EnemyGrid::UArchonsReplicationGraphNode_EnemyGrid()
+{
+    bRequiresPrepareForReplicationCall = true;
+}
+
+void UArchonsReplicationGraphNode_EnemyGrid::NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+    Enemies.Add(ActorInfo.Actor);
+}
+
+bool UArchonsReplicationGraphNode_EnemyGrid::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+    const bool bRemoved{Enemies.RemoveSwap(ActorInfo.Actor, EAllowShrinking::No) > 0};
+
+    if (!bRemoved && bWarnIfNotFound)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Enemy grid node could not remove %s, it was never added."), *GetNameSafe(ActorInfo.Actor));
+    }
+
+    return bRemoved;
+}
+
+void UArchonsReplicationGraphNode_EnemyGrid::NotifyResetAllNetworkActors()
+{
+    Enemies.Reset();
+    Cells.Reset();
+    NumAwakeEnemies = 0;
+}
+
+void UArchonsReplicationGraphNode_EnemyGrid::PrepareForReplication()
+{
+    SCOPE_CYCLE_COUNTER(STAT_ArchonsEnemyGridPrepare);
+
+    const float CellSize{FMath::Max(CVarNetEnemyCellSize.GetValueOnGameThread(), 100.0f)};
+
+    // Lists are kept between frames so enemies staying in the same cells don't reallocate anything
+    for (TPair<FIntPoint, FActorRepListRefView>& Cell : Cells)
+    {
+        Cell.Value.Reset();
+    }
+
+    NumAwakeEnemies = 0;
+
+    for (AActor* Actor : Enemies)
+    {
+        // Enemies going dormant must still be gathered until their channels have sent the final state and gone dormant,
+        // past that the replication graph skips them per connection without replicating anything
+        Cells.FindOrAdd(GetCell(Actor->GetActorLocation(), CellSize)).Add(Actor);
+
+        if (Actor->NetDormancy <= DORM_Awake)
+        {
+            ++NumAwakeEnemies;
+        }
+    }
+
+    for (auto It = Cells.CreateIterator(); It; ++It)
+    {
+        if (It.Value().Num() == 0)
+        {
+            It.RemoveCurrent();
+        }
+    }
+}
+
+void UArchonsReplicationGraphNode_EnemyGrid::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+    SCOPE_CYCLE_COUNTER(STAT_ArchonsEnemyGridGather);
+
+    if (Cells.Num() == 0) { return; }
+
+    const float CellSize{FMath::Max(CVarNetEnemyCellSize.GetValueOnGameThread(), 100.0f)};
+    const int32 NearCells{FMath::Max(CVarNetEnemyNearCells.GetValueOnGameThread(), 0)};
+    const int32 FarCells{FMath::Max(CVarNetEnemyFarCells.GetValueOnGameThread(), NearCells)};
+    const uint32 FarFrameStride{static_cast<uint32>(FMath::Max(CVarNetEnemyFarFrameStride.GetValueOnGameThread(), 1))};
+    const bool bGatherFar{Params.ReplicationFrameNum % FarFrameStride == 0};
+
+    // Both ends of the span are what the player looks at, the view location is only used when there is no span
+    TArray<FIntPoint, TInlineAllocator<8>> ViewerCells;
+    for (const FNetViewer& Viewer : Params.Viewers)
+    {
+        FVector PointA;
+        FVector PointB;
+
+        const ISpanAbilityOwner* SpanAbilityOwner{Cast<ISpanAbilityOwner>(Viewer.InViewer)};
+        if (SpanAbilityOwner && SpanAbilityOwner->GetAbilitySpan(PointA, PointB))
+        {
+            ViewerCells.AddUnique(GetCell(PointA, CellSize));
+            ViewerCells.AddUnique(GetCell(PointB, CellSize));
+        }
+        else
+        {
+            ViewerCells.AddUnique(GetCell(Viewer.ViewLocation, CellSize));
+        }
+    }
+
+    // Only populated cells exist, so walking them is cheaper than walking the range around every viewer
+    for (const TPair<FIntPoint, FActorRepListRefView>& Cell : Cells)
+    {
+        int32 Distance{MAX_int32};
+        for (const FIntPoint& ViewerCell : ViewerCells)
+        {
+            Distance = FMath::Min(Distance, FMath::Max(FMath::Abs(Cell.Key.X - ViewerCell.X), FMath::Abs(Cell.Key.Y - ViewerCell.Y)));
+        }
+
+        if (Distance <= NearCells || (bGatherFar && Distance <= FarCells))
+        {
+            Params.OutGatheredReplicationLists.AddReplicationActorList(Cell.Value);
+        }
+    }
+}
+
+int32 UArchonsReplicationGraphNode_EnemyGrid::GetNumEnemies() const
+{
+    return Enemies.Num();
+}
+
+int32 UArchonsReplicationGraphNode_EnemyGrid::GetNumAwakeEnemies() const
+{
+    return NumAwakeEnemies;
+}
+
+int32 UArchonsReplicationGraphNode_EnemyGrid::GetNumCells() const
+{
+    return Cells.Num();
+}
+
+void UArchonsReplicationGraph::InitGlobalActorClassSettings()
+{
+    Super::InitGlobalActorClassSettings();
+
+    FClassReplicationInfo EnemyClassInfo{GlobalActorReplicationInfoMap.GetClassInfo(AEnemyCharacter::StaticClass())};
+
+    // The enemy grid node does its own culling
+    EnemyClassInfo.SetCullDistanceSquared(0.0f);
+
+    // Far enemies skip frames, their channels must outlive the gap or they would be closed and reopened over and over
+    const int32 FarFrameStride{FMath::Max(CVarNetEnemyFarFrameStride.GetValueOnGameThread(), 1)};
+    EnemyClassInfo.ActorChannelFrameTimeout = static_cast<uint8>(FMath::Clamp(FarFrameStride * 2, static_cast<int32>(EnemyClassInfo.ActorChannelFrameTimeout), 255));
+
+    for (TObjectIterator<UClass> It; It; ++It)
+    {
+        if (It->IsChildOf(AEnemyCharacter::StaticClass()))
+        {
+            GlobalActorReplicationInfoMap.SetClassInfo(*It, EnemyClassInfo);
+        }
+    }
+}
+
+void UArchonsReplicationGraph::InitGlobalGraphNodes()
+{
+    Super::InitGlobalGraphNodes();
+
+    EnemyGridNode = CreateNewNode<UArchonsReplicationGraphNode_EnemyGrid>();
+    AddGlobalGraphNode(EnemyGridNode);
+}
+
+void UArchonsReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+    if (ActorInfo.Actor->IsA<AEnemyCharacter>())
+    {
+        EnemyGridNode->NotifyAddNetworkActor(ActorInfo);
+        return;
+    }
+
+    Super::RouteAddNetworkActorToNodes(ActorInfo, GlobalInfo);
+}
+
+void UArchonsReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+    if (ActorInfo.Actor->IsA<AEnemyCharacter>())
+    {
+        EnemyGridNode->NotifyRemoveNetworkActor(ActorInfo);
+        return;
+    }
+
+    Super::RouteRemoveNetworkActorToNodes(ActorInfo);
+}
+
+UArchonsReplicationGraphNode_EnemyGrid* UArchonsReplicationGraph::GetEnemyGridNode() const
+{
+    return EnemyGridNode;
+}
@@ -0,0 +1,63 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BasicReplicationGraph.h"
+#include "ArchonsReplicationGraph.generated.h"
+
+/**
+ * Buckets enemies in a 2D grid and gathers the cells around both ends of each connection's character span.
+ * Cells close to a character are gathered every frame, cells further out only every few frames and everything past that is culled.
+ * Dead enemies go dormant while they play their death animation. They stay in the cells so their final state still goes out,
+ * after that the replication graph skips them on every connection their channel went dormant on.
+ */
+UCLASS()
+class ARCHONS_API UArchonsReplicationGraphNode_EnemyGrid : public UReplicationGraphNode
+{
+    GENERATED_BODY()
+
+public:
+    UArchonsReplicationGraphNode_EnemyGrid();
+
+    virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override;
+    virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+    virtual void NotifyResetAllNetworkActors() override;
+
+    virtual void PrepareForReplication() override;
+    virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+
+    int32 GetNumEnemies() const;
+    int32 GetNumAwakeEnemies() const;
+    int32 GetNumCells() const;
+
+private:
+    TArray<AActor*> Enemies;
+    TMap<FIntPoint, FActorRepListRefView> Cells;
+    int32 NumAwakeEnemies = 0;
+};
+
+/**
+ * Replication graph for dedicated and listen servers. Enemies go through the enemy grid node,
+ * everything else is routed the same way the basic replication graph does it.
+ *
+ * Tweak with the Archons.Net.* console variables, Archons.Net.Report logs bytes per connection.
+ */
+UCLASS(Transient, Config=Engine)
+class ARCHONS_API UArchonsReplicationGraph : public UBasicReplicationGraph
+{
+    GENERATED_BODY()
+
+public:
+    virtual void InitGlobalActorClassSettings() override;
+    virtual void InitGlobalGraphNodes() override;
+
+    virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+    virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+
+    UArchonsReplicationGraphNode_EnemyGrid* GetEnemyGridNode() const;
+
+private:
+    UPROPERTY()
+    UArchonsReplicationGraphNode_EnemyGrid* EnemyGridNode;
+};
@@ -0,0 +1,330 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "ArenaSnapshotSubsystem.h"
+
+#include "EngineUtils.h"
+#include "EnemySpawnerComponent.h"
+#include "Archons/Abilities/StringAbilityComponent.h"
+#include "Archons/Enemies/EnemyCharacter.h"
+#include "Archons/Player/MainPlayerController.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+    constexpr int32 SnapshotVersion = 1;
+
+    // Reload timing has to survive the world being torn down, so it can't live on the subsystem
+    double MapReloadStartTime = 0.0;
+    FDelegateHandle MapReloadHandle;
+
+    void RestoreCharacter(ACharacter* Character, const FTransform& Transform)
+    {
+        if (!IsValid(Character)) { return; }
+
+        if (UPawnMovementComponent* MovementComponent{Character->GetMovementComponent()})
+        {
+            MovementComponent->StopMovementImmediately();
+        }
+
+        Character->SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+    }
+}
+
+FArchive& operator<<(FArchive& Ar, FArenaSnapshot& Snapshot)
+{
+    int32 Version{SnapshotVersion};
+    Ar << Version;
+
+    if (Version != SnapshotVersion)
+    {
+        Ar.SetError();
+        return Ar;
+    }
+
+    Ar << Snapshot.LeftCharacterTransform;
+    Ar << Snapshot.RightCharacterTransform;
+
+    Ar << Snapshot.AbilityPeriod;
+    Ar << Snapshot.AbilityAmplitude;
+    Ar << Snapshot.AbilityHarmonic;
+    Ar << Snapshot.AbilityDamageRadius;
+    Ar << Snapshot.bAbilityActive;
+    Ar << Snapshot.AbilityElapsedTime;
+
+    int32 NumEnemies{Snapshot.Enemies.Num()};
+    Ar << NumEnemies;
+
+    if (Ar.IsLoading())
+    {
+        Snapshot.Enemies.SetNum(FMath::Max(NumEnemies, 0));
+    }
+
+    for (FArenaEnemySnapshot& Enemy : Snapshot.Enemies)
+    {
+        uint8 Target{static_cast<uint8>(Enemy.Target)};
+
+        Ar << Enemy.Transform;
+        Ar << Enemy.Health;
+        Ar << Target;
+
+        Enemy.Target = static_cast<EArenaSnapshotTarget>(Target);
+    }
+
+    Ar << Snapshot.PendingRespawns;
+
+    return Ar;
+}
+
+void UArenaSnapshotSubsystem::Capture(const FName Name)
+{
+    const AMainPlayerController* MainPlayerController{GetMainPlayerController()};
+    if (!MainPlayerController) { return; }
+
+    ACharacter* LeftCharacter{MainPlayerController->GetLeftCharacter()};
+    ACharacter* RightCharacter{MainPlayerController->GetRightCharacter()};
+
+    FArenaSnapshot Snapshot;
+    Snapshot.LeftCharacterTransform = IsValid(LeftCharacter) ? LeftCharacter->GetActorTransform() : FTransform::Identity;
+    Snapshot.RightCharacterTransform = IsValid(RightCharacter) ? RightCharacter->GetActorTransform() : FTransform::Identity;
+
+    if (const UStringAbilityComponent* Ability{MainPlayerController->GetStringAbilityComponent()})
+    {
+        Snapshot.AbilityPeriod = Ability->GetPeriod();
+        Snapshot.AbilityAmplitude = Ability->GetAmplitude();
+        Snapshot.AbilityHarmonic = Ability->GetHarmonic();
+        Snapshot.AbilityDamageRadius = Ability->GetDamageRadius();
+        Snapshot.bAbilityActive = Ability->IsAbilityActive();
+        Snapshot.AbilityElapsedTime = Ability->GetElapsedTime();
+    }
+
+    for (TActorIterator<AEnemyCharacter> It(GetWorld()); It; ++It)
+    {
+        if (It->IsDead())
+        {
+            ++Snapshot.PendingRespawns;
+            continue;
+        }
+
+        const ACharacter* Target{It->GetCurrentTarget()};
+        FArenaEnemySnapshot& Enemy{Snapshot.Enemies.AddDefaulted_GetRef()};
+        Enemy.Transform = It->GetActorTransform();
+        Enemy.Health = It->GetHealth();
+        Enemy.Target = !Target ? EArenaSnapshotTarget::None : Target == LeftCharacter ? EArenaSnapshotTarget::LeftCharacter : EArenaSnapshotTarget::RightCharacter;
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Captured arena snapshot %s with %i enemies."), *Name.ToString(), Snapshot.Enemies.Num());
+
+    Snapshots.Add(Name, MoveTemp(Snapshot));
+}
+
+bool UArenaSnapshotSubsystem::Restore(const FName Name)
+{
+    const FArenaSnapshot* Snapshot{Snapshots.Find(Name)};
+    if (!Snapshot)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("No arena snapshot named %s."), *Name.ToString());
+        return false;
+    }
+
+    AMainPlayerController* MainPlayerController{GetMainPlayerController()};
+    if (!MainPlayerController) { return false; }
+
+    const double StartTime{FPlatformTime::Seconds()};
+
+    ACharacter* LeftCharacter{MainPlayerController->GetLeftCharacter()};
+    ACharacter* RightCharacter{MainPlayerController->GetRightCharacter()};
+    RestoreCharacter(LeftCharacter, Snapshot->LeftCharacterTransform);
+    RestoreCharacter(RightCharacter, Snapshot->RightCharacterTransform);
+
+    if (UStringAbilityComponent* Ability{MainPlayerController->GetStringAbilityComponent()})
+    {
+        Ability->RestoreState(Snapshot->AbilityPeriod, Snapshot->AbilityAmplitude, Snapshot->AbilityHarmonic, Snapshot->AbilityDamageRadius, Snapshot->bAbilityActive, Snapshot->AbilityElapsedTime);
+    }
+
+    // Living enemies are reused as they are, dying ones would broadcast their death later and trigger a respawn, so they go now
+    TArray<AEnemyCharacter*> ReusableEnemies;
+    for (TActorIterator<AEnemyCharacter> It(GetWorld()); It; ++It)
+    {
+        if (It->IsDead())
+        {
+            It->Destroy();
+            continue;
+        }
+
+        ReusableEnemies.Add(*It);
+    }
+
+    UEnemySpawnerComponent* EnemySpawner{GetEnemySpawner()};
+    int32 NumRestored{0};
+
+    for (int32 Index = 0; Index < Snapshot->Enemies.Num(); ++Index)
+    {
+        const FArenaEnemySnapshot& EnemySnapshot{Snapshot->Enemies[Index]};
+
+        AEnemyCharacter* Enemy{ReusableEnemies.IsValidIndex(Index) ? ReusableEnemies[Index] : nullptr};
+        if (!Enemy && EnemySpawner)
+        {
+            Enemy = EnemySpawner->SpawnEnemyAt(EnemySnapshot.Transform);
+        }
+
+        if (!Enemy) { continue; }
+
+        ACharacter* Target{EnemySnapshot.Target == EArenaSnapshotTarget::LeftCharacter ? LeftCharacter : EnemySnapshot.Target == EArenaSnapshotTarget::RightCharacter ? RightCharacter : nullptr};
+        Enemy->RestoreState(EnemySnapshot.Transform, EnemySnapshot.Health, Target);
+        ++NumRestored;
+    }
+
+    for (int32 Index = Snapshot->Enemies.Num(); Index < ReusableEnemies.Num(); ++Index)
+    {
+        ReusableEnemies[Index]->Destroy();
+    }
+
+    if (EnemySpawner && EnemySpawner->IsSpawning() && Snapshot->PendingRespawns > 0)
+    {
+        EnemySpawner->StartSpawning(Snapshot->PendingRespawns);
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Restored arena snapshot %s with %i enemies (%i reused) in %.2f ms."),
+        *Name.ToString(), NumRestored, FMath::Min(ReusableEnemies.Num(), Snapshot->Enemies.Num()), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+    return true;
+}
+
+bool UArenaSnapshotSubsystem::Save(const FName Name) const
+{
+    const FArenaSnapshot* Snapshot{Snapshots.Find(Name)};
+    if (!Snapshot) { return false; }
+
+    TArray<uint8> Bytes;
+    FMemoryWriter Writer(Bytes);
+    Writer << const_cast<FArenaSnapshot&>(*Snapshot);
+
+    return FFileHelper::SaveArrayToFile(Bytes, *GetSnapshotFilePath(Name));
+}
+
+bool UArenaSnapshotSubsystem::Load(const FName Name)
+{
+    TArray<uint8> Bytes;
+    if (!FFileHelper::LoadFileToArray(Bytes, *GetSnapshotFilePath(Name))) { return false; }
+
+    FArenaSnapshot Snapshot;
+    FMemoryReader Reader(Bytes);
+    Reader << Snapshot;
+
+    if (Reader.IsError())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Arena snapshot %s could not be read."), *Name.ToString());
+        return false;
+    }
+
+    Snapshots.Add(Name, MoveTemp(Snapshot));
+    return true;
+}
+
+bool UArenaSnapshotSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+AMainPlayerController* UArenaSnapshotSubsystem::GetMainPlayerController() const
+{
+    return Cast<AMainPlayerController>(UGameplayStatics::GetPlayerController(GetWorld(), 0));
+}
+
+UEnemySpawnerComponent* UArenaSnapshotSubsystem::GetEnemySpawner() const
+{
+    for (TObjectIterator<UEnemySpawnerComponent> It; It; ++It)
+    {
+        if (It->GetWorld() == GetWorld())
+        {
+            return *It;
+        }
+    }
+
+    return nullptr;
+}
+
+FString UArenaSnapshotSubsystem::GetSnapshotFilePath(const FName Name)
+{
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Snapshots"), Name.ToString() + TEXT(".snapshot"));
+}
+
+static FName GetSnapshotName(const TArray<FString>& Args)
+{
+    return Args.IsValidIndex(0) ? FName(*Args[0]) : FName(TEXT("Default"));
+}
+
+static UArenaSnapshotSubsystem* GetSnapshotSubsystem(UWorld* World)
+{
+    return World ? World->GetSubsystem<UArenaSnapshotSubsystem>() : nullptr;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CaptureSnapshotCommand(
+    TEXT("Archons.Snapshot.Capture"),
+    TEXT("Archons.Snapshot.Capture [Name=Default]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+    {
+        if (UArenaSnapshotSubsystem* Subsystem{GetSnapshotSubsystem(World)})
+        {
+            Subsystem->Capture(GetSnapshotName(Args));
+        }
+    }));
+
+static FAutoConsoleCommandWithWorldAndArgs RestoreSnapshotCommand(
+    TEXT("Archons.Snapshot.Restore"),
+    TEXT("Archons.Snapshot.Restore [Name=Default]"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+    {
+        if (UArenaSnapshotSubsystem* Subsystem{GetSnapshotSubsystem(World)})
+        {
+            Subsystem->Restore(GetSnapshotName(Args));
+        }
+    }));
+
+static FAutoConsoleCommandWithWorldAndArgs SaveSnapshotCommand(
+    TEXT("Archons.Snapshot.Save"),
+    TEXT("Archons.Snapshot.Save [Name=Default] - writes a captured snapshot to Saved/Snapshots"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+    {
+        if (UArenaSnapshotSubsystem* Subsystem{GetSnapshotSubsystem(World)})
+        {
+            Subsystem->Save(GetSnapshotName(Args));
+        }
+    }));
+
+static FAutoConsoleCommandWithWorldAndArgs LoadSnapshotCommand(
+    TEXT("Archons.Snapshot.Load"),
+    TEXT("Archons.Snapshot.Load [Name=Default] - reads a snapshot from Saved/Snapshots, restore it with Archons.Snapshot.Restore"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+    {
+        if (UArenaSnapshotSubsystem* Subsystem{GetSnapshotSubsystem(World)})
+        {
+            Subsystem->Load(GetSnapshotName(Args));
+        }
+    }));
+
+// Baseline for the restore timings: restarts the level and logs how long it takes until the new map is loaded
+static FAutoConsoleCommandWithWorld TimeMapReloadCommand(
+    TEXT("Archons.Snapshot.TimeMapReload"),
+    TEXT("Restarts the level and logs the time until the map is loaded again"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        APlayerController* PlayerController{World ? World->GetFirstPlayerController() : nullptr};
+        if (!PlayerController) { return; }
+
+        FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(MapReloadHandle);
+        MapReloadHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddLambda([](UWorld*)
+        {
+            UE_LOG(LogTemp, Display, TEXT("Map reload took %.2f ms."), (FPlatformTime::Seconds() - MapReloadStartTime) * 1000.0);
+            FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(MapReloadHandle);
+        });
+
+        MapReloadStartTime = FPlatformTime::Seconds();
+        PlayerController->RestartLevel();
+    }));
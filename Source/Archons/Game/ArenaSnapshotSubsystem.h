@@ -0,0 +1,72 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ArenaSnapshotSubsystem.generated.h"
+
+class AMainPlayerController;
+class UEnemySpawnerComponent;
+
+enum class EArenaSnapshotTarget : uint8
+{
+    None,
+    LeftCharacter,
+    RightCharacter
+};
+
+struct FArenaEnemySnapshot
+{
+    FTransform Transform;
+    float Health = 0.0f;
+    EArenaSnapshotTarget Target = EArenaSnapshotTarget::None;
+};
+
+struct FArenaSnapshot
+{
+    FTransform LeftCharacterTransform;
+    FTransform RightCharacterTransform;
+
+    double AbilityPeriod = 0.0;
+    float AbilityAmplitude = 0.0f;
+    int32 AbilityHarmonic = 0;
+    float AbilityDamageRadius = 0.0f;
+    bool bAbilityActive = false;
+    double AbilityElapsedTime = 0.0;
+
+    TArray<FArenaEnemySnapshot> Enemies;
+
+    // Enemies that were dying when the snapshot was taken, respawned through the spawner on restore
+    int32 PendingRespawns = 0;
+
+    friend FArchive& operator<<(FArchive& Ar, FArenaSnapshot& Snapshot);
+};
+
+/**
+ * Captures the arena (characters, ability parameters and phase, every living enemy) and restores it in place,
+ * reusing the actors that already exist instead of reloading the map. Snapshots live in memory and can be saved to Saved/Snapshots.
+ */
+UCLASS()
+class ARCHONS_API UArenaSnapshotSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    void Capture(const FName Name);
+    bool Restore(const FName Name);
+
+    bool Save(const FName Name) const;
+    bool Load(const FName Name);
+
+protected:
+    virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+    TMap<FName, FArenaSnapshot> Snapshots;
+
+    AMainPlayerController* GetMainPlayerController() const;
+    UEnemySpawnerComponent* GetEnemySpawner() const;
+
+    static FString GetSnapshotFilePath(const FName Name);
+};
@@ -2,18 +2,31 @@
 
 #include "EnemySpawnerComponent.h"
 
+#include "EngineUtils.h"
+#include "HitchWatchdogSubsystem.h"
 #include "NavigationSystem.h"
 #include "AI/NavigationSystemBase.h"
+#include "Archons/Archons.h"
 #include "Archons/Enemies/EnemyCharacter.h"
 #include "Kismet/GameplayStatics.h"
+#include "NavMesh/RecastNavMesh.h"
 
 UEnemySpawnerComponent::UEnemySpawnerComponent()
 {
-    PrimaryComponentTick.bCanEverTick = false;
+    // Only watches for the navigation going busy, so build times are accurate to a frame
+    PrimaryComponentTick.bCanEverTick = true;
 
     bDisabled = false;
     bShouldRespawn = false;
     SpawnRadius = 1000.0f;
+    NavigationInvokerMargin = 1000.0f;
+
+    PendingSpawns = 0;
+
+    NavigationIdleTime = 0.0;
+    NavigationBuilds = 0;
+    LastNavigationBuildTime = 0.0;
+    TotalNavigationBuildTime = 0.0;
 }
 
 void UEnemySpawnerComponent::BeginPlay()
@@ -25,6 +38,59 @@ void UEnemySpawnerComponent::BeginPlay()
 
     NavigationSystemRef = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
     ensureAlways(NavigationSystemRef.IsValid());
+
+    if (NavigationSystemRef.IsValid())
+    {
+        NavigationIdleTime = FPlatformTime::Seconds();
+        NavigationSystemRef->OnNavigationGenerationFinishedDelegate.AddDynamic(this, &UEnemySpawnerComponent::HandleNavigationGenerationFinished);
+
+        // Invoker tiles are only built by navmeshes generated at runtime, a map overriding the Dynamic default of DefaultEngine.ini would never get any
+        for (const ANavigationData* NavigationData : NavigationSystemRef->NavDataSet)
+        {
+            if (NavigationData && NavigationData->GetRuntimeGenerationMode() != ERuntimeGenerationType::Dynamic)
+            {
+                UE_LOG(LogTemp, Warning, TEXT("%s is not generated dynamically, enemies will not find navmesh around the player. Set its Runtime Generation to Dynamic."), *NavigationData->GetName());
+            }
+        }
+    }
+
+    // Navmesh tiles are only generated around invokers, so keep the whole spawn area around the player covered
+    if (PlayerControllerRef.IsValid())
+    {
+        PlayerControllerRef->OnPossessedPawnChanged.AddDynamic(this, &UEnemySpawnerComponent::HandlePossessedPawnChanged);
+        SetNavigationInvoker(PlayerControllerRef->GetPawn());
+    }
+
+    GetWorld()->GetTimerManager().SetTimer(NavigationTimerHandle, this, &UEnemySpawnerComponent::RetryPendingSpawns, 0.25f, true);
+}
+
+void UEnemySpawnerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (PlayerControllerRef.IsValid())
+    {
+        PlayerControllerRef->OnPossessedPawnChanged.RemoveDynamic(this, &UEnemySpawnerComponent::HandlePossessedPawnChanged);
+    }
+
+    SetNavigationInvoker(nullptr);
+
+    if (NavigationSystemRef.IsValid())
+    {
+        NavigationSystemRef->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UEnemySpawnerComponent::HandleNavigationGenerationFinished);
+    }
+
+    GetWorld()->GetTimerManager().ClearTimer(NavigationTimerHandle);
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void UEnemySpawnerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    if (NavigationSystemRef.IsValid() && !NavigationSystemRef->IsNavigationBuildInProgress())
+    {
+        NavigationIdleTime = FPlatformTime::Seconds();
+    }
 }
 
 void UEnemySpawnerComponent::StartSpawning(const int32 NumberOfEnemies)
@@ -42,16 +108,37 @@ void UEnemySpawnerComponent::StartSpawning(const int32 NumberOfEnemies)
 void UEnemySpawnerComponent::StopSpawning()
 {
     bShouldRespawn = false;
+    PendingSpawns = 0;
 }
 
 void UEnemySpawnerComponent::SpawnEnemy()
 {
-    if (!PlayerControllerRef.IsValid() || !NavigationSystemRef.IsValid()) { return; }
+    if (TrySpawnEnemy()) { return; }
+
+    // Tiles around the player may still be building, try again once they are done instead of dropping the enemy
+    if (NavigationSystemRef.IsValid() && NavigationSystemRef->IsNavigationBuildInProgress())
+    {
+        ++PendingSpawns;
+        ARCHONS_LOG_RATE_LIMITED(1.0, Display, TEXT("Navigation is still building, deferring enemy spawn (%i pending)."), PendingSpawns);
+    }
+}
+
+bool UEnemySpawnerComponent::TrySpawnEnemy()
+{
+    FHitchWatchdogScope HitchScope(EHitchWatchdogTimer::Spawning);
+    UHitchWatchdogSubsystem::Count(EHitchWatchdogCounter::SpawnsAttempted);
+
+    if (!PlayerControllerRef.IsValid() || !NavigationSystemRef.IsValid())
+    {
+        UHitchWatchdogSubsystem::Count(EHitchWatchdogCounter::SpawnsFailed);
+        return false;
+    }
 
     const APawn* PlayerPawn{PlayerControllerRef->GetPawn()}; // PlayerPawn could be nullptr if the game is simulated in the editor
     const FVector SpawnCenter{PlayerPawn ? PlayerPawn->GetActorLocation() : FVector::ZeroVector};
 
     // Sometimes spawn can fail because of collisions, so we use a retry mechanism here.
+    // Every spawn can fail this way when the spawn area is blocked, so the warnings are rate limited to keep a flood of them from adding to the hitch.
     constexpr int32 MaxAttempts{5};
     for (int AttemptNumber = 1; AttemptNumber <= MaxAttempts; ++AttemptNumber)
     {
@@ -65,23 +152,76 @@ void UEnemySpawnerComponent::SpawnEnemy()
                 EnemyCharacter->SpawnDefaultController();
                 EnemyCharacter->CharacterDiedDelegate.AddDynamic(this, &UEnemySpawnerComponent::HandleEnemyDeath);
 
-                return;
+                return true;
             }
 
-            UE_LOG(LogTemp, Warning, TEXT("Spawning enemy failed."))
+            ARCHONS_LOG_RATE_LIMITED(1.0, Warning, TEXT("Spawning enemy failed."));
         }
         else
         {
-            UE_LOG(LogTemp, Warning, TEXT("Unable to find a spawn location for an enemy."));
+            ARCHONS_LOG_RATE_LIMITED(1.0, Warning, TEXT("Unable to find a spawn location for an enemy."));
         }
 
-        if (AttemptNumber <= MaxAttempts)
+        if (AttemptNumber < MaxAttempts)
         {
-            UE_LOG(LogTemp, Warning, TEXT("Trying again."));
+            ARCHONS_LOG_RATE_LIMITED(1.0, Warning, TEXT("Trying again."));
         }
     }
 
-    UE_LOG(LogTemp, Warning, TEXT("Abandoning spawn attempts after %i tries."), MaxAttempts);
+    ARCHONS_LOG_RATE_LIMITED(1.0, Warning, TEXT("Abandoning spawn attempts after %i tries."), MaxAttempts);
+    UHitchWatchdogSubsystem::Count(EHitchWatchdogCounter::SpawnsFailed);
+
+    return false;
+}
+
+AEnemyCharacter* UEnemySpawnerComponent::SpawnEnemyAt(const FTransform& Transform)
+{
+    FActorSpawnParameters SpawnParameters;
+    SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+    AEnemyCharacter* EnemyCharacter{GetWorld()->SpawnActor<AEnemyCharacter>(EnemyClass, Transform, SpawnParameters)};
+    if (!EnemyCharacter) { return nullptr; }
+
+    EnemyCharacter->SpawnDefaultController();
+    EnemyCharacter->CharacterDiedDelegate.AddDynamic(this, &UEnemySpawnerComponent::HandleEnemyDeath);
+
+    return EnemyCharacter;
+}
+
+bool UEnemySpawnerComponent::IsSpawning() const
+{
+    return bShouldRespawn;
+}
+
+void UEnemySpawnerComponent::HandleNavigationGenerationFinished(ANavigationData* NavigationData)
+{
+    // Track how long each incremental navmesh build takes, from the last frame the navigation was idle until the generator runs out of tasks
+    const double Now{FPlatformTime::Seconds()};
+    LastNavigationBuildTime = Now - NavigationIdleTime;
+    TotalNavigationBuildTime += LastNavigationBuildTime;
+    ++NavigationBuilds;
+    NavigationIdleTime = Now;
+
+    RetryPendingSpawns();
+}
+
+void UEnemySpawnerComponent::RetryPendingSpawns()
+{
+    if (!NavigationSystemRef.IsValid()) { return; }
+
+    const bool bBuildInProgress{NavigationSystemRef->IsNavigationBuildInProgress()};
+    const int32 SpawnsToRetry{PendingSpawns};
+    for (int32 Index = 0; Index < SpawnsToRetry && bShouldRespawn; ++Index)
+    {
+        if (!TrySpawnEnemy())
+        {
+            // Stop retrying when the navmesh is done and there is still no place to spawn
+            PendingSpawns = bBuildInProgress ? PendingSpawns : 0;
+            return;
+        }
+
+        --PendingSpawns;
+    }
 }
 
 void UEnemySpawnerComponent::HandleEnemyDeath()
@@ -91,3 +231,58 @@ void UEnemySpawnerComponent::HandleEnemyDeath()
         SpawnEnemy();
     }
 }
+
+void UEnemySpawnerComponent::HandlePossessedPawnChanged(APawn* OldPawn, APawn* NewPawn)
+{
+    SetNavigationInvoker(NewPawn);
+}
+
+void UEnemySpawnerComponent::SetNavigationInvoker(AActor* Invoker)
+{
+    if (NavigationInvokerRef.Get() == Invoker) { return; }
+
+    if (NavigationInvokerRef.IsValid())
+    {
+        UNavigationSystemV1::UnregisterNavigationInvoker(NavigationInvokerRef.Get());
+    }
+
+    NavigationInvokerRef = Invoker;
+
+    if (Invoker)
+    {
+        UNavigationSystemV1::RegisterNavigationInvoker(Invoker, SpawnRadius + NavigationInvokerMargin, SpawnRadius + 2.0f * NavigationInvokerMargin);
+    }
+}
+
+void UEnemySpawnerComponent::LogNavigationReport() const
+{
+    if (!NavigationSystemRef.IsValid()) { return; }
+
+    for (const ANavigationData* NavigationData : NavigationSystemRef->NavDataSet)
+    {
+        if (!NavigationData) { continue; }
+
+        const ARecastNavMesh* RecastNavMesh{Cast<ARecastNavMesh>(NavigationData)};
+        const uint32 MemoryUsed{NavigationData->LogMemUsed()};
+
+        UE_LOG(LogTemp, Display, TEXT("%s: %u KB, %i tiles"), *NavigationData->GetName(), MemoryUsed / 1024, RecastNavMesh ? RecastNavMesh->GetNavMeshTilesCount() : 0);
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Navigation builds: %i, last %.1f ms, average %.1f ms, %i tasks remaining, %i spawns pending"),
+        NavigationBuilds, LastNavigationBuildTime * 1000.0, NavigationBuilds > 0 ? TotalNavigationBuildTime * 1000.0 / NavigationBuilds : 0.0,
+        NavigationSystemRef->GetNumRemainingBuildTasks(), PendingSpawns);
+}
+
+static FAutoConsoleCommandWithWorld NavigationReportCommand(
+    TEXT("Archons.Navigation.Report"),
+    TEXT("Logs navmesh memory, tile count and incremental build times"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        for (TObjectIterator<UEnemySpawnerComponent> It; It; ++It)
+        {
+            if (It->GetWorld() == World)
+            {
+                It->LogNavigationReport();
+            }
+        }
+    }));
@@ -6,8 +6,10 @@
 #include "Components/ActorComponent.h"
 #include "EnemySpawnerComponent.generated.h"
 
+class APawn;
 class UNavigationSystemV1;
 class AEnemyCharacter;
+class ANavigationData;
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class ARCHONS_API UEnemySpawnerComponent : public UActorComponent
@@ -28,13 +30,20 @@ class ARCHONS_API UEnemySpawnerComponent : public UActorComponent
     UPROPERTY(EditAnywhere)
     float SpawnRadius;
 
+    // Navmesh is generated around the player pawn up to SpawnRadius plus this margin, and removed past twice the margin
+    UPROPERTY(EditAnywhere, meta=(ClampMin=0.0f))
+    float NavigationInvokerMargin;
+
 public:
     UEnemySpawnerComponent();
 
 protected:
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
+    virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
     UFUNCTION(BlueprintCallable)
     void StartSpawning(const int32 NumberOfEnemies);
 
@@ -42,8 +51,41 @@ public:
     void StopSpawning();
 
 private:
+    // Spawns that could not find a location while the navmesh around the player was still building
+    int32 PendingSpawns;
+
+    TWeakObjectPtr<AActor> NavigationInvokerRef;
+    FTimerHandle NavigationTimerHandle;
+
+    // Last time the navigation was seen idle. There is no build started event for invoker tiles, so builds are timed from here,
+    // which makes them at most a frame too long.
+    double NavigationIdleTime;
+    int32 NavigationBuilds;
+    double LastNavigationBuildTime;
+    double TotalNavigationBuildTime;
+
     void SpawnEnemy();
+    bool TrySpawnEnemy();
+
+    void RetryPendingSpawns();
+
+    UFUNCTION()
+    void HandleNavigationGenerationFinished(ANavigationData* NavigationData);
 
     UFUNCTION()
     void HandleEnemyDeath();
+
+    // The player pawn may only be possessed after BeginPlay, or be replaced later, so the invoker follows possession
+    UFUNCTION()
+    void HandlePossessedPawnChanged(APawn* OldPawn, APawn* NewPawn);
+
+    void SetNavigationInvoker(AActor* Invoker);
+
+public:
+    void LogNavigationReport() const;
+
+    // Spawns an enemy at an exact transform, wired up for respawning like any other spawned enemy
+    AEnemyCharacter* SpawnEnemyAt(const FTransform& Transform);
+
+    bool IsSpawning() const;
 };
@@ -0,0 +1,184 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "HitchWatchdogSubsystem.h"
+
+#include "Archons/Archons.h"
+#include "Async/Async.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<float> CVarHitchBudgetMs(
+    TEXT("Archons.Hitch.BudgetMs"), 100.0f,
+    TEXT("Frames taking longer than this dump the gameplay history, 0 disables the watchdog"));
+
+static TAutoConsoleVariable<int32> CVarHitchHistoryFrames(
+    TEXT("Archons.Hitch.HistoryFrames"), 600,
+    TEXT("Number of frames kept in the history. Read when the world is created"));
+
+static TAutoConsoleVariable<float> CVarHitchMinDumpInterval(
+    TEXT("Archons.Hitch.MinDumpInterval"), 10.0f,
+    TEXT("Minimum seconds between two dumps, so a long stretch of slow frames does not write a file every frame"));
+
+static FAutoConsoleCommandWithWorld HitchDumpCommand(
+    TEXT("Archons.Hitch.Dump"),
+    TEXT("Dumps the gameplay history of the last frames right away"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        if (UHitchWatchdogSubsystem* Subsystem{World ? World->GetSubsystem<UHitchWatchdogSubsystem>() : nullptr})
+        {
+            Subsystem->DumpHistory(TEXT("Requested from the console"));
+        }
+    }));
+
+namespace
+{
+    // Filled by gameplay code during the frame and moved into the history by the subsystem tick
+    FHitchWatchdogFrame CurrentFrame;
+    int32 EnemiesAlive = 0;
+
+    const TCHAR* CounterNames[]{TEXT("PeaksFired"), TEXT("SpawnsAttempted"), TEXT("SpawnsFailed"), TEXT("DamageEvents")};
+    const TCHAR* TimerNames[]{TEXT("StringAbilityMs"), TEXT("PeakDamageMs"), TEXT("StringDamageMs"), TEXT("SpawningMs")};
+
+    static_assert(UE_ARRAY_COUNT(CounterNames) == static_cast<int32>(EHitchWatchdogCounter::Num));
+    static_assert(UE_ARRAY_COUNT(TimerNames) == static_cast<int32>(EHitchWatchdogTimer::Num));
+}
+
+FHitchWatchdogScope::FHitchWatchdogScope(const EHitchWatchdogTimer InTimer) : Timer(InTimer), StartCycles(FPlatformTime::Cycles64())
+{
+}
+
+FHitchWatchdogScope::~FHitchWatchdogScope()
+{
+    if (!IsInGameThread()) { return; }
+
+    CurrentFrame.TimerMs[static_cast<int32>(Timer)] += static_cast<float>(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+}
+
+void UHitchWatchdogSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    History.SetNum(FMath::Max(CVarHitchHistoryFrames.GetValueOnGameThread(), 1));
+}
+
+void UHitchWatchdogSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    const double Now{FPlatformTime::Seconds()};
+    const float BudgetMs{CVarHitchBudgetMs.GetValueOnGameThread()};
+
+    // Everything gathered since the previous tick happened during the time measured here, so both go into the same entry
+    if (BudgetMs > 0.0f && bHasLastTickTime)
+    {
+        FHitchWatchdogFrame& Frame{CurrentFrame};
+        Frame.FrameNumber = GFrameCounter;
+        Frame.WorldTime = GetWorld()->TimeSeconds;
+        Frame.FrameMs = static_cast<float>((Now - LastTickTime) * 1000.0);
+        Frame.EnemiesAlive = EnemiesAlive;
+        AddToHistory(Frame);
+
+        if (Frame.FrameMs > BudgetMs && Now - LastDumpTime >= CVarHitchMinDumpInterval.GetValueOnGameThread())
+        {
+            DumpHistory(FString::Printf(TEXT("Frame %llu took %.1f ms (budget %.1f ms)"), Frame.FrameNumber, Frame.FrameMs, BudgetMs));
+        }
+    }
+
+    LastTickTime = Now;
+    bHasLastTickTime = true;
+
+    CurrentFrame = FHitchWatchdogFrame();
+}
+
+TStatId UHitchWatchdogSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UHitchWatchdogSubsystem, STATGROUP_Archons);
+}
+
+void UHitchWatchdogSubsystem::Count(const EHitchWatchdogCounter Counter, const int32 Amount)
+{
+    if (!IsInGameThread()) { return; }
+
+    CurrentFrame.Counters[static_cast<int32>(Counter)] += Amount;
+}
+
+void UHitchWatchdogSubsystem::AdjustEnemiesAlive(const int32 Delta)
+{
+    if (!IsInGameThread()) { return; }
+
+    EnemiesAlive = FMath::Max(EnemiesAlive + Delta, 0);
+}
+
+void UHitchWatchdogSubsystem::SetAbilityPhase(const float Phase)
+{
+    if (!IsInGameThread()) { return; }
+
+    CurrentFrame.AbilityPhase = Phase;
+}
+
+void UHitchWatchdogSubsystem::DumpHistory(const FString& Reason)
+{
+    LastDumpTime = FPlatformTime::Seconds();
+
+    // Only the copy happens here, formatting and writing run on a background thread so the dump does not stretch the hitch it reports
+    TArray<FHitchWatchdogFrame> Frames;
+    Frames.Reserve(NumHistoryFrames);
+
+    const int32 FirstIndex{(NextHistoryIndex - NumHistoryFrames + History.Num()) % History.Num()};
+    for (int32 Index = 0; Index < NumHistoryFrames; ++Index)
+    {
+        Frames.Add(History[(FirstIndex + Index) % History.Num()]);
+    }
+
+    const FString FilePath{FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Hitches"), FString::Printf(TEXT("Hitch_%s_%llu.csv"), *FDateTime::Now().ToString(), GFrameCounter))};
+
+    ARCHONS_LOG_RATE_LIMITED(1.0, Warning, TEXT("%s, writing the last %i frames to %s"), *Reason, Frames.Num(), *FilePath);
+
+    AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Frames = MoveTemp(Frames), Reason, FilePath]()
+    {
+        FString Csv;
+        Csv.Reserve(128 * (Frames.Num() + 2));
+
+        Csv += FString::Printf(TEXT("# %s\n"), *Reason);
+        Csv += TEXT("Frame,WorldTime,FrameMs,AbilityPhase,EnemiesAlive");
+        for (const TCHAR* CounterName : CounterNames)
+        {
+            Csv += TEXT(",");
+            Csv += CounterName;
+        }
+        for (const TCHAR* TimerName : TimerNames)
+        {
+            Csv += TEXT(",");
+            Csv += TimerName;
+        }
+        Csv += TEXT("\n");
+
+        for (const FHitchWatchdogFrame& Frame : Frames)
+        {
+            Csv += FString::Printf(TEXT("%llu,%.3f,%.2f,%.3f,%i"), Frame.FrameNumber, Frame.WorldTime, Frame.FrameMs, Frame.AbilityPhase, Frame.EnemiesAlive);
+            for (const int32 Counter : Frame.Counters)
+            {
+                Csv += FString::Printf(TEXT(",%i"), Counter);
+            }
+            for (const float TimerMs : Frame.TimerMs)
+            {
+                Csv += FString::Printf(TEXT(",%.3f"), TimerMs);
+            }
+            Csv += TEXT("\n");
+        }
+
+        FFileHelper::SaveStringToFile(Csv, *FilePath);
+    });
+}
+
+bool UHitchWatchdogSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UHitchWatchdogSubsystem::AddToHistory(const FHitchWatchdogFrame& Frame)
+{
+    History[NextHistoryIndex] = Frame;
+    NextHistoryIndex = (NextHistoryIndex + 1) % History.Num();
+    NumHistoryFrames = FMath::Min(NumHistoryFrames + 1, History.Num());
+}
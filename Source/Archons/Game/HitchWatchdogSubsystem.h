@@ -0,0 +1,93 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HitchWatchdogSubsystem.generated.h"
+
+enum class EHitchWatchdogCounter : uint8
+{
+    PeaksFired,
+    SpawnsAttempted,
+    SpawnsFailed,
+    DamageEvents,
+    Num
+};
+
+enum class EHitchWatchdogTimer : uint8
+{
+    StringAbility,
+    PeakDamage,
+    StringDamage,
+    Spawning,
+    Num
+};
+
+struct FHitchWatchdogFrame
+{
+    uint64 FrameNumber = 0;
+    double WorldTime = 0.0;
+    float FrameMs = 0.0f;
+
+    // Normalized position in the oscillation cycle, negative while the ability is inactive
+    float AbilityPhase = -1.0f;
+    int32 EnemiesAlive = 0;
+
+    int32 Counters[static_cast<int32>(EHitchWatchdogCounter::Num)] = {};
+    float TimerMs[static_cast<int32>(EHitchWatchdogTimer::Num)] = {};
+};
+
+// Adds the time spent in its scope to the current frame's timer
+struct ARCHONS_API FHitchWatchdogScope
+{
+    explicit FHitchWatchdogScope(const EHitchWatchdogTimer InTimer);
+    ~FHitchWatchdogScope();
+
+private:
+    EHitchWatchdogTimer Timer;
+    uint64 StartCycles;
+};
+
+/**
+ * Keeps the gameplay metrics of the last frames in a ring buffer and dumps it to Saved/Hitches as CSV whenever a frame
+ * takes longer than Archons.Hitch.BudgetMs. Gameplay code reports through the static functions and FHitchWatchdogScope,
+ * which only touch a fixed-size struct, so they are cheap enough to leave on everywhere.
+ * Each entry pairs the time between two subsystem ticks with everything reported in between, so the row of a slow frame
+ * holds that frame's own counters and timings.
+ *
+ * Counters are gathered on the game thread for the whole process, so with several PIE worlds they end up in the first one to tick.
+ */
+UCLASS()
+class ARCHONS_API UHitchWatchdogSubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+    /** FTickableGameObject */
+    virtual void Tick(float DeltaTime) override;
+    virtual TStatId GetStatId() const override;
+
+    static void Count(const EHitchWatchdogCounter Counter, const int32 Amount = 1);
+    static void AdjustEnemiesAlive(const int32 Delta);
+    static void SetAbilityPhase(const float Phase);
+
+    void DumpHistory(const FString& Reason);
+
+protected:
+    virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+    TArray<FHitchWatchdogFrame> History;
+    int32 NextHistoryIndex = 0;
+    int32 NumHistoryFrames = 0;
+
+    // Time of the previous tick, a frame's duration is the time between two ticks, the span its gameplay was recorded in
+    double LastTickTime = 0.0;
+    bool bHasLastTickTime = false;
+    double LastDumpTime = -MAX_dbl;
+
+    void AddToHistory(const FHitchWatchdogFrame& Frame);
+};
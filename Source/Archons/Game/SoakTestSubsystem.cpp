@@ -0,0 +1,358 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "SoakTestSubsystem.h"
+
+#include "AIController.h"
+#include "EngineUtils.h"
+#include "TimerManager.h"
+#include "Algo/Count.h"
+#include "Archons/Archons.h"
+#include "Archons/Enemies/EnemyCharacter.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Navigation/PathFollowingComponent.h"
+#include "UObject/UObjectHash.h"
+
+static TAutoConsoleVariable<float> CVarSoakKillsPerSecond(
+    TEXT("Archons.Soak.KillsPerSecond"), 2.0f,
+    TEXT("Number of enemies killed per second while soaking"));
+
+static TAutoConsoleVariable<float> CVarSoakSampleInterval(
+    TEXT("Archons.Soak.SampleInterval"), 30.0f,
+    TEXT("Seconds between two samples"));
+
+static TAutoConsoleVariable<float> CVarSoakWarmupTime(
+    TEXT("Archons.Soak.WarmupTime"), 120.0f,
+    TEXT("Seconds to wait before the baseline sample is taken"));
+
+static TAutoConsoleVariable<float> CVarSoakDuration(
+    TEXT("Archons.Soak.Duration"), 4.0f * 60.0f * 60.0f,
+    TEXT("Soak length in seconds, 0 runs until stopped"));
+
+static TAutoConsoleVariable<float> CVarSoakMaxGrowthPercent(
+    TEXT("Archons.Soak.MaxGrowthPercent"), 10.0f,
+    TEXT("Allowed growth of any tracked count over the baseline, in percent"));
+
+static TAutoConsoleVariable<int32> CVarSoakMinGrowth(
+    TEXT("Archons.Soak.MinGrowth"), 32,
+    TEXT("Absolute growth of a tracked count that is always tolerated, so small counts do not fail on noise"));
+
+static TAutoConsoleVariable<float> CVarSoakMaxMemoryGrowthMB(
+    TEXT("Archons.Soak.MaxMemoryGrowthMB"), 256.0f,
+    TEXT("Allowed growth of used physical memory over the baseline, in megabytes"));
+
+static FAutoConsoleCommandWithWorld SoakStartCommand(
+    TEXT("Archons.Soak.Start"),
+    TEXT("Starts killing enemies and sampling memory and object counts"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        if (USoakTestSubsystem* Subsystem{World ? World->GetSubsystem<USoakTestSubsystem>() : nullptr})
+        {
+            Subsystem->StartSoak(false);
+        }
+    }));
+
+static FAutoConsoleCommandWithWorld SoakStopCommand(
+    TEXT("Archons.Soak.Stop"),
+    TEXT("Stops the running soak"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        if (USoakTestSubsystem* Subsystem{World ? World->GetSubsystem<USoakTestSubsystem>() : nullptr})
+        {
+            Subsystem->StopSoak(true);
+        }
+    }));
+
+namespace
+{
+    // Object hashes also hold objects that are unreachable but not yet collected, which is exactly what a leak looks like
+    int32 CountObjectsInWorld(const UClass* Class, const UWorld* World)
+    {
+        TArray<UObject*> Objects;
+        GetObjectsOfClass(Class, Objects);
+
+        return static_cast<int32>(Algo::CountIf(Objects, [World](const UObject* Object) { return Object->GetWorld() == World; }));
+    }
+
+    // FTimerManager keeps its timers to itself, but ListTimers ends its log with "------- N Total Timers -------".
+    // It logs every timer on the way there, once per sample is cheap enough for a soak.
+    class FTimerCountOutputDevice : public FOutputDevice
+    {
+    public:
+        int32 NumTimers = INDEX_NONE;
+
+        virtual void Serialize(const TCHAR* Message, ELogVerbosity::Type Verbosity, const FName& Category) override
+        {
+            if (!FCString::Strstr(Message, TEXT(" Total Timers "))) { return; }
+
+            while (*Message && !FChar::IsDigit(*Message))
+            {
+                ++Message;
+            }
+
+            NumTimers = FCString::Atoi(Message);
+        }
+    };
+
+    int32 CountTimers(const FTimerManager& TimerManager)
+    {
+        FTimerCountOutputDevice OutputDevice;
+        GLog->AddOutputDevice(&OutputDevice);
+        TimerManager.ListTimers();
+        GLog->Flush();
+        GLog->RemoveOutputDevice(&OutputDevice);
+
+        return OutputDevice.NumTimers;
+    }
+}
+
+void USoakTestSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &USoakTestSubsystem::HandlePreGarbageCollect);
+    PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &USoakTestSubsystem::HandlePostGarbageCollect);
+}
+
+void USoakTestSubsystem::Deinitialize()
+{
+    FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+    FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+
+    Super::Deinitialize();
+}
+
+void USoakTestSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+    Super::OnWorldBeginPlay(InWorld);
+
+    if (FParse::Param(FCommandLine::Get(), TEXT("ArchonsSoak")))
+    {
+        StartSoak(true);
+    }
+}
+
+void USoakTestSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    KillRandomEnemies(DeltaTime);
+
+    const double Time{FPlatformTime::Seconds() - StartTime};
+    if (Time < NextSampleTime) { return; }
+
+    NextSampleTime = Time + FMath::Max(CVarSoakSampleInterval.GetValueOnGameThread(), 1.0f);
+
+    const FSoakTestSample Sample{TakeSample(Time)};
+    WriteSample(Sample);
+
+    if (!bHasBaseline)
+    {
+        if (Time >= CVarSoakWarmupTime.GetValueOnGameThread())
+        {
+            Baseline = Sample;
+            bHasBaseline = true;
+        }
+
+        return;
+    }
+
+    if (!CheckGrowth(Sample))
+    {
+        StopSoak(false);
+        return;
+    }
+
+    const float Duration{CVarSoakDuration.GetValueOnGameThread()};
+    if (Duration > 0.0f && Time >= Duration)
+    {
+        StopSoak(true);
+    }
+}
+
+TStatId USoakTestSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(USoakTestSubsystem, STATGROUP_Archons);
+}
+
+bool USoakTestSubsystem::IsTickable() const
+{
+    return bRunning;
+}
+
+void USoakTestSubsystem::StartSoak(const bool bInExitWhenDone)
+{
+    if (bRunning) { return; }
+
+    bRunning = true;
+    bExitWhenDone = bInExitWhenDone;
+    bHasBaseline = false;
+
+    StartTime = FPlatformTime::Seconds();
+    NextSampleTime = 0.0;
+    KillBudget = 0.0f;
+    Kills = 0;
+
+    OutputFilePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Soak"), FString::Printf(TEXT("Soak_%s.csv"), *FDateTime::Now().ToString()));
+    FFileHelper::SaveStringToFile(TEXT("Time,Kills,UObjects,Enemies,EnemyObjects,DyingEnemies,AIControllers,PathFollowingComponents,EnemyTargetTimers,ActiveTimers,DeathDelegateBindings,MaxDeathDelegateBindingsPerEnemy,GarbageCollections,LastGarbageCollectionMs,UsedPhysicalMB\n"), *OutputFilePath);
+
+    UE_LOG(LogTemp, Display, TEXT("Soak started, writing samples to %s"), *OutputFilePath);
+}
+
+void USoakTestSubsystem::StopSoak(const bool bSucceeded)
+{
+    if (!bRunning) { return; }
+
+    bRunning = false;
+
+    if (bSucceeded)
+    {
+        UE_LOG(LogTemp, Display, TEXT("Soak finished after %i kills."), Kills);
+    }
+    else
+    {
+        UE_LOG(LogTemp, Error, TEXT("Soak failed after %i kills, see %s"), Kills, *OutputFilePath);
+    }
+
+    if (bExitWhenDone)
+    {
+        FPlatformMisc::RequestExitWithStatus(false, bSucceeded ? 0 : 1);
+    }
+}
+
+bool USoakTestSubsystem::IsRunning() const
+{
+    return bRunning;
+}
+
+bool USoakTestSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void USoakTestSubsystem::KillRandomEnemies(const float DeltaTime)
+{
+    KillBudget += CVarSoakKillsPerSecond.GetValueOnGameThread() * DeltaTime;
+    if (KillBudget < 1.0f) { return; }
+
+    TArray<AEnemyCharacter*> AliveEnemies;
+    for (TActorIterator<AEnemyCharacter> It(GetWorld()); It; ++It)
+    {
+        if (!It->IsDead())
+        {
+            AliveEnemies.Add(*It);
+        }
+    }
+
+    // Kills go through the regular damage path, so the death animation, destroy and respawn all run as in production
+    while (KillBudget >= 1.0f && AliveEnemies.Num() > 0)
+    {
+        KillBudget -= 1.0f;
+
+        const int32 Index{FMath::RandHelper(AliveEnemies.Num())};
+        AEnemyCharacter* Enemy{AliveEnemies[Index]};
+        AliveEnemies.RemoveAtSwap(Index);
+
+        UGameplayStatics::ApplyDamage(Enemy, Enemy->GetHealth(), nullptr, nullptr, UDamageType::StaticClass());
+        ++Kills;
+    }
+
+    // Don't bank kills while everything is dead or respawning
+    KillBudget = FMath::Min(KillBudget, 1.0f);
+}
+
+FSoakTestSample USoakTestSubsystem::TakeSample(const double Time) const
+{
+    FSoakTestSample Sample;
+    Sample.Time = Time;
+    Sample.Kills = Kills;
+    Sample.UObjects = GUObjectArray.GetObjectArrayNumMinusAvailable();
+    Sample.GarbageCollections = GarbageCollections;
+    Sample.LastGarbageCollectionMs = LastGarbageCollectionMs;
+    Sample.UsedPhysicalMemory = FPlatformMemory::GetStats().UsedPhysical;
+
+    for (TActorIterator<AEnemyCharacter> It(GetWorld()); It; ++It)
+    {
+        ++Sample.Enemies;
+        Sample.DyingEnemies += It->IsDead() ? 1 : 0;
+        Sample.EnemyTargetTimers += It->IsTargetTimerActive() ? 1 : 0;
+
+        const int32 DeathDelegateBindings{It->CharacterDiedDelegate.GetAllObjects().Num()};
+        Sample.DeathDelegateBindings += DeathDelegateBindings;
+        Sample.MaxDeathDelegateBindingsPerEnemy = FMath::Max(Sample.MaxDeathDelegateBindingsPerEnemy, DeathDelegateBindings);
+    }
+
+    Sample.EnemyObjects = CountObjectsInWorld(AEnemyCharacter::StaticClass(), GetWorld());
+    Sample.AIControllers = CountObjectsInWorld(AAIController::StaticClass(), GetWorld());
+    Sample.PathFollowingComponents = CountObjectsInWorld(UPathFollowingComponent::StaticClass(), GetWorld());
+    Sample.ActiveTimers = CountTimers(GetWorld()->GetTimerManager());
+
+    return Sample;
+}
+
+void USoakTestSubsystem::WriteSample(const FSoakTestSample& Sample) const
+{
+    const FString Line{FString::Printf(TEXT("%.1f,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%i,%.2f,%.1f\n"),
+        Sample.Time, Sample.Kills, Sample.UObjects, Sample.Enemies, Sample.EnemyObjects, Sample.DyingEnemies, Sample.AIControllers, Sample.PathFollowingComponents,
+        Sample.EnemyTargetTimers, Sample.ActiveTimers, Sample.DeathDelegateBindings, Sample.MaxDeathDelegateBindingsPerEnemy, Sample.GarbageCollections, Sample.LastGarbageCollectionMs,
+        static_cast<double>(Sample.UsedPhysicalMemory) / (1024.0 * 1024.0))};
+
+    FFileHelper::SaveStringToFile(Line, *OutputFilePath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+bool USoakTestSubsystem::CheckGrowth(const FSoakTestSample& Sample) const
+{
+    const float MaxGrowthPercent{CVarSoakMaxGrowthPercent.GetValueOnGameThread()};
+    const int32 MinGrowth{CVarSoakMinGrowth.GetValueOnGameThread()};
+
+    bool bPassed{true};
+    auto CheckCount = [&](const TCHAR* Name, const int32 BaselineCount, const int32 Count)
+    {
+        const int32 Growth{Count - BaselineCount};
+        const float AllowedGrowth{FMath::Max(static_cast<float>(BaselineCount) * MaxGrowthPercent / 100.0f, static_cast<float>(MinGrowth))};
+
+        if (static_cast<float>(Growth) > AllowedGrowth)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Soak: %s grew from %i to %i (allowed %.0f)"), Name, BaselineCount, Count, AllowedGrowth);
+            bPassed = false;
+        }
+    };
+
+    CheckCount(TEXT("UObjects"), Baseline.UObjects, Sample.UObjects);
+    CheckCount(TEXT("Enemies"), Baseline.Enemies, Sample.Enemies);
+    CheckCount(TEXT("Enemy objects"), Baseline.EnemyObjects, Sample.EnemyObjects);
+    CheckCount(TEXT("Dying enemies"), Baseline.DyingEnemies, Sample.DyingEnemies);
+    CheckCount(TEXT("AI controllers"), Baseline.AIControllers, Sample.AIControllers);
+    CheckCount(TEXT("Path following components"), Baseline.PathFollowingComponents, Sample.PathFollowingComponents);
+    CheckCount(TEXT("Enemy target timers"), Baseline.EnemyTargetTimers, Sample.EnemyTargetTimers);
+    CheckCount(TEXT("Active timers"), Baseline.ActiveTimers, Sample.ActiveTimers);
+    CheckCount(TEXT("Death delegate bindings"), Baseline.DeathDelegateBindings, Sample.DeathDelegateBindings);
+
+    // Every enemy is bound exactly as often at any point of the loop, so a single extra binding is already a leak
+    if (Sample.MaxDeathDelegateBindingsPerEnemy > Baseline.MaxDeathDelegateBindingsPerEnemy)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Soak: an enemy has %i death delegate bindings, baseline was %i"), Sample.MaxDeathDelegateBindingsPerEnemy, Baseline.MaxDeathDelegateBindingsPerEnemy);
+        bPassed = false;
+    }
+
+    const double MemoryGrowthMB{(static_cast<double>(Sample.UsedPhysicalMemory) - static_cast<double>(Baseline.UsedPhysicalMemory)) / (1024.0 * 1024.0)};
+    if (MemoryGrowthMB > CVarSoakMaxMemoryGrowthMB.GetValueOnGameThread())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Soak: used physical memory grew by %.1f MB"), MemoryGrowthMB);
+        bPassed = false;
+    }
+
+    return bPassed;
+}
+
+void USoakTestSubsystem::HandlePreGarbageCollect()
+{
+    GarbageCollectionStartTime = FPlatformTime::Seconds();
+}
+
+void USoakTestSubsystem::HandlePostGarbageCollect()
+{
+    ++GarbageCollections;
+    LastGarbageCollectionMs = (FPlatformTime::Seconds() - GarbageCollectionStartTime) * 1000.0;
+}
@@ -0,0 +1,87 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SoakTestSubsystem.generated.h"
+
+struct FSoakTestSample
+{
+    double Time = 0.0;
+    int32 Kills = 0;
+    int32 UObjects = 0;
+    int32 Enemies = 0;
+    // Enemy objects including destroyed ones the garbage collector has not freed yet, unlike Enemies
+    int32 EnemyObjects = 0;
+    int32 DyingEnemies = 0;
+    int32 AIControllers = 0;
+    int32 PathFollowingComponents = 0;
+    int32 EnemyTargetTimers = 0;
+    // Every timer of the world's timer manager, so leaked timers show up whoever set them. -1 while the LogEngine category is suppressed.
+    int32 ActiveTimers = 0;
+    // Handlers bound to the enemies' death delegates, a binding that is added again on every respawn shows up here
+    int32 DeathDelegateBindings = 0;
+    int32 MaxDeathDelegateBindingsPerEnemy = 0;
+    int32 GarbageCollections = 0;
+    double LastGarbageCollectionMs = 0.0;
+    uint64 UsedPhysicalMemory = 0;
+};
+
+/**
+ * Soak mode for the spawn/die/respawn loop. Kills random enemies at a fixed rate, samples object counts, timers,
+ * garbage collection and memory at intervals, writes them to Saved/Soak as CSV and fails when anything grows past a threshold.
+ *
+ * Start with "-ArchonsSoak" on the command line (usually together with -nullrhi) or the Archons.Soak.Start console command.
+ * Tweak with the Archons.Soak.* console variables.
+ */
+UCLASS()
+class ARCHONS_API USoakTestSubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+    virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+    /** FTickableGameObject */
+    virtual void Tick(float DeltaTime) override;
+    virtual TStatId GetStatId() const override;
+    virtual bool IsTickable() const override;
+
+    void StartSoak(const bool bInExitWhenDone);
+    void StopSoak(const bool bSucceeded);
+
+    bool IsRunning() const;
+
+protected:
+    virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+    bool bRunning = false;
+    bool bExitWhenDone = false;
+    bool bHasBaseline = false;
+
+    double StartTime = 0.0;
+    double NextSampleTime = 0.0;
+    float KillBudget = 0.0f;
+    int32 Kills = 0;
+
+    int32 GarbageCollections = 0;
+    double GarbageCollectionStartTime = 0.0;
+    double LastGarbageCollectionMs = 0.0;
+    FDelegateHandle PreGarbageCollectHandle;
+    FDelegateHandle PostGarbageCollectHandle;
+
+    FSoakTestSample Baseline;
+    FString OutputFilePath;
+
+    void KillRandomEnemies(const float DeltaTime);
+    FSoakTestSample TakeSample(const double Time) const;
+    void WriteSample(const FSoakTestSample& Sample) const;
+    bool CheckGrowth(const FSoakTestSample& Sample) const;
+
+    void HandlePreGarbageCollect();
+    void HandlePostGarbageCollect();
+};
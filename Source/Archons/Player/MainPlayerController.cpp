@@ -4,6 +4,7 @@
 #include "EnhancedInputSubsystems.h"
 #include "EnhancedInputComponent.h"
 #include "MainPlayerCamera.h"
+#include "NavigationSystem.h"
 #include "Archons/Abilities/StringAbilityComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "GameFramework/Character.h"
@@ -11,6 +12,62 @@
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 
+namespace
+{
+    FString GetTickGroupName(const ETickingGroup TickGroup)
+    {
+        return StaticEnum<ETickingGroup>()->GetNameStringByValue(TickGroup);
+    }
+
+    void LogTickFunction(FTickFunction& TickFunction)
+    {
+        if (!TickFunction.IsTickFunctionRegistered()) { return; }
+
+        UE_LOG(LogTemp, Display, TEXT("%s: %s (last ran in %s), %s, %s"),
+            *TickFunction.DiagnosticMessage(), *GetTickGroupName(TickFunction.TickGroup), *GetTickGroupName(TickFunction.ActualStartTickGroup),
+            TickFunction.bRunOnAnyThread ? TEXT("any thread") : TEXT("game thread"), TickFunction.IsTickFunctionEnabled() ? TEXT("enabled") : TEXT("disabled"));
+
+        for (const FTickPrerequisite& Prerequisite : TickFunction.GetPrerequisites())
+        {
+            if (FTickFunction* PrerequisiteTickFunction{Prerequisite.Get()})
+            {
+                UE_LOG(LogTemp, Display, TEXT("    after %s"), *PrerequisiteTickFunction->DiagnosticMessage());
+            }
+        }
+    }
+
+    void LogActorTickFunctions(AActor* Actor)
+    {
+        if (!IsValid(Actor)) { return; }
+
+        LogTickFunction(Actor->PrimaryActorTick);
+
+        for (UActorComponent* Component : Actor->GetComponents())
+        {
+            LogTickFunction(Component->PrimaryComponentTick);
+        }
+    }
+}
+
+static FAutoConsoleCommandWithWorld DumpTicksCommand(
+    TEXT("Archons.Ticks.Dump"),
+    TEXT("Logs tick groups, threads and prerequisites of the player controller, the string ability and both characters"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        AMainPlayerController* MainPlayerController{Cast<AMainPlayerController>(UGameplayStatics::GetPlayerController(World, 0))};
+        if (!MainPlayerController) { return; }
+
+        LogActorTickFunctions(MainPlayerController);
+
+        if (UStringAbilityComponent* Ability{MainPlayerController->GetStringAbilityComponent()})
+        {
+            LogTickFunction(Ability->GetSolverTickFunction());
+        }
+
+        LogActorTickFunctions(MainPlayerController->GetLeftCharacter());
+        LogActorTickFunctions(MainPlayerController->GetRightCharacter());
+    }));
+
 AMainPlayerController::AMainPlayerController()
 {
     StringAbilityComponent = CreateDefaultSubobject<UStringAbilityComponent>(TEXT("StringAbility"));
@@ -23,6 +80,9 @@ AMainPlayerController::AMainPlayerController()
 
     LeftCharacterRef = nullptr;
     RightCharacterRef = nullptr;
+
+    NavigationInvokerRadius = 2000.0f;
+    NavigationInvokerRemovalRadius = 3000.0f;
 }
 
 void AMainPlayerController::BeginPlay()
@@ -37,9 +97,41 @@ void AMainPlayerController::BeginPlay()
     ensureAlwaysMsgf(LeftCharacterRef, TEXT("Character with class %s was not found in the level"), LeftCharacterClass ? *LeftCharacterClass->GetName() : TEXT("None"));
     ensureAlwaysMsgf(RightCharacterRef, TEXT("Character with class %s was not found in the level"), RightCharacterClass ? *RightCharacterClass->GetName() : TEXT("None"));
 
+    // Enemies chase the characters, so the navmesh has to follow them
+    for (ACharacter* Character : {LeftCharacterRef, RightCharacterRef})
+    {
+        if (IsValid(Character))
+        {
+            UNavigationSystemV1::RegisterNavigationInvoker(Character, NavigationInvokerRadius, NavigationInvokerRemovalRadius);
+        }
+    }
+
+    // Movement consumes the input this controller gathers in its tick, and the ability reads the span,
+    // so the order is controller, then both characters' movement, then the ability
+    for (const ACharacter* Character : {LeftCharacterRef, RightCharacterRef})
+    {
+        if (!IsValid(Character) || !Character->GetMovementComponent()) { continue; }
+
+        Character->GetMovementComponent()->AddTickPrerequisiteActor(this);
+        StringAbilityComponent->AddTickPrerequisiteComponent(Character->GetMovementComponent());
+    }
+
     StringAbilityComponent->ActivateAbility();
 }
 
+void AMainPlayerController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    for (ACharacter* Character : {LeftCharacterRef, RightCharacterRef})
+    {
+        if (IsValid(Character))
+        {
+            UNavigationSystemV1::UnregisterNavigationInvoker(Character);
+        }
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
 void AMainPlayerController::SetupInputComponent()
 {
     Super::SetupInputComponent();
@@ -56,10 +148,16 @@ void AMainPlayerController::SetupInputComponent()
     }
 }
 
-void AMainPlayerController::Tick(float DeltaSeconds)
+void AMainPlayerController::UpdateCameraManager(float DeltaSeconds)
 {
-    Super::Tick(DeltaSeconds);
+    // Move the camera first, the camera manager reads its view from it
+    FollowCharacters();
+
+    Super::UpdateCameraManager(DeltaSeconds);
+}
 
+void AMainPlayerController::FollowCharacters()
+{
     if (!IsValid(LeftCharacterRef) || !IsValid(RightCharacterRef) || !IsValid(MainPlayerCameraRef)) { return; }
 
     FVector CameraPos = UKismetMathLibrary::VLerp(LeftCharacterRef->GetActorLocation(), RightCharacterRef->GetActorLocation(), 0.5f);
@@ -127,3 +225,8 @@ ACharacter* AMainPlayerController::GetRightCharacter() const
 {
     return RightCharacterRef;
 }
+
+UStringAbilityComponent* AMainPlayerController::GetStringAbilityComponent() const
+{
+    return StringAbilityComponent;
+}
@@ -39,10 +39,18 @@ class ARCHONS_API AMainPlayerController : public APlayerController, public ISpan
     UPROPERTY(VisibleAnywhere)
     ACharacter* RightCharacterRef;
 
+    // Navmesh tiles are generated within this radius around each character
+    UPROPERTY(EditDefaultsOnly, Category="Navigation", meta=(ClampMin=0.0f))
+    float NavigationInvokerRadius;
+
+    UPROPERTY(EditDefaultsOnly, Category="Navigation", meta=(ClampMin=0.0f))
+    float NavigationInvokerRemovalRadius;
+
 public:
     AMainPlayerController();
 
-    virtual void Tick(float DeltaSeconds) override;
+    // Runs after every actor has ticked, so the camera frames where the characters ended up this frame
+    virtual void UpdateCameraManager(float DeltaSeconds) override;
 
 protected:
     UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
@@ -52,9 +60,12 @@ protected:
     AMainPlayerCamera* MainPlayerCameraRef;
 
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
     virtual void SetupInputComponent() override;
 
 private:
+    void FollowCharacters();
+
     void OnMoveLeftCharacter_Triggered(const FInputActionValue& InputActionValue);
     void OnMoveRightCharacter_Triggered(const FInputActionValue& InputActionValue);
 
@@ -66,4 +77,5 @@ public:
     /** Getters and Setters */
     ACharacter* GetLeftCharacter() const;
     ACharacter* GetRightCharacter() const;
+    UStringAbilityComponent* GetStringAbilityComponent() const;
 };
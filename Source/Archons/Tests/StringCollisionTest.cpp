@@ -0,0 +1,69 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "Archons/Abilities/StringCollision.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStringCollisionSweptTest, "Archons.String.Collision.SweptHits",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FStringCollisionSweptTest::RunTest(const FString& Parameters)
+{
+    constexpr float Thickness = 10.0f;
+    constexpr float CapsuleRadius = 34.0f;
+    constexpr float CapsuleHalfHeight = 54.0f;
+    constexpr int32 NumSegments = 64;
+    constexpr double StringLength = 1500.0;
+
+    // A straight string jumping 125 cm sideways in one tick, as at amplitude 200 and period 1 ticking at 10 Hz
+    TArray<FVector> PreviousPoints;
+    TArray<FVector> StringPoints;
+    for (int32 Segment = 0; Segment <= NumSegments; ++Segment)
+    {
+        const double Along{StringLength * Segment / NumSegments};
+        PreviousPoints.Add(FVector(Along, -60.0, 0.0));
+        StringPoints.Add(FVector(Along, 65.0, 0.0));
+    }
+
+    // The string lies at foot height, a capsule radius below the lowest point of the axis, so sideways it reaches less than the hit distance
+    const double Reach{FMath::Sqrt(FMath::Square(CapsuleRadius + Thickness) - FMath::Square(CapsuleRadius))};
+
+    // Every capsule center from one side of the sweep to the other, plus a centimeter within and beyond reach on both sides
+    TArray<double> Offsets;
+    for (double Offset = -60.0; Offset <= 65.0; Offset += 5.0)
+    {
+        Offsets.Add(Offset);
+    }
+    Offsets.Add(-60.0 - Reach + 1.0);
+    Offsets.Add(-60.0 - Reach - 1.0);
+    Offsets.Add(65.0 + Reach - 1.0);
+    Offsets.Add(65.0 + Reach + 1.0);
+
+    FStringCollisionCapsules Capsules;
+    Capsules.Reset(FVector::ZeroVector, FVector::XAxisVector);
+    for (int32 Index = 0; Index < Offsets.Num(); ++Index)
+    {
+        Capsules.Add(FVector(StringLength * 0.5 + Index, Offsets[Index], CapsuleHalfHeight + CapsuleRadius), CapsuleHalfHeight, CapsuleRadius, Index);
+    }
+    Capsules.Finalize();
+
+    TBitArray<> Hits;
+    Capsules.FindSweptHits(PreviousPoints, StringPoints, Thickness, Hits);
+
+    TBitArray<> EndHits;
+    Capsules.FindHits(StringPoints, Thickness, EndHits);
+
+    for (int32 Index = 0; Index < Capsules.Num(); ++Index)
+    {
+        const double Offset{Offsets[Capsules.GetSourceIndex(Index)]};
+        const bool bInSweep{Offset >= -60.0 - Reach && Offset <= 65.0 + Reach};
+        TestTrue(FString::Printf(TEXT("Capsule at %g cm is hit only within reach of the sweep"), Offset), static_cast<bool>(Hits[Index]) == bInSweep);
+    }
+
+    TestTrue(TEXT("Testing only the current string misses capsules it passed over"), EndHits.CountSetBits() < Hits.CountSetBits());
+
+    return true;
+}
+
+#endif
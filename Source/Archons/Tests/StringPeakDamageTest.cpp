@@ -0,0 +1,214 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "Archons/Abilities/StringPeakDamage.h"
+#include "Archons/Abilities/StringPeakKernels.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace StringPeakDamageTest
+{
+    constexpr double Period = 1.7;
+    constexpr double Duration = 12.0;
+    constexpr double Amplitude = 150.0;
+    constexpr double DamageRadius = 100.0;
+    constexpr int32 Harmonic = 3;
+    constexpr int32 NumTargets = 200;
+
+    // Default character capsule, standing on the plane of the string
+    constexpr double CapsuleRadius = 34.0;
+    constexpr double CapsuleHalfHeight = 88.0;
+    const FVector CapsuleHalfAxis{FVector::ZAxisVector * (CapsuleHalfHeight - CapsuleRadius)};
+
+    // Interpolating between samples dt apart is off by at most acceleration * dt^2 / 8. The trajectories below accelerate by less than 900 cm/s^2,
+    // about a centimeter at 10 Hz, so targets closer than this to the edge of the damage radius may go either way and are left out of the comparison
+    constexpr double AmbiguousBand = 2.0;
+
+    // Targets sway across the arena at up to about 350 cm/s while circling, so ticking at 10 Hz without interpolation misses some of them
+    constexpr double SwayFrequency = 0.4;
+
+    struct FTrajectory
+    {
+        FVector Base;
+        FVector Sway;
+        double Radius;
+        double AngularSpeed;
+        double Phase;
+
+        FVector Evaluate(const double Time) const
+        {
+            const double Angle{AngularSpeed * Time + Phase};
+            return Base + Sway * FMath::Sin(SwayFrequency * Time + Phase) + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0) * Radius;
+        }
+    };
+
+    StringPeakDamage::FSpanSample GetSpan(const double Time)
+    {
+        return {
+            Time,
+            FVector(-600.0 + 80.0 * FMath::Sin(0.9 * Time), 60.0 * FMath::Cos(0.7 * Time), 0.0),
+            FVector(600.0 + 50.0 * FMath::Sin(1.1 * Time), -40.0 * FMath::Sin(0.5 * Time), 0.0)
+        };
+    }
+
+    TArray<FTrajectory> MakeTrajectories()
+    {
+        FRandomStream Random(7);
+        TArray<FTrajectory> Trajectories;
+        for (int32 Index = 0; Index < NumTargets; ++Index)
+        {
+            FTrajectory& Trajectory{Trajectories.AddDefaulted_GetRef()};
+            Trajectory.Base = FVector(Random.FRandRange(-800.0, 800.0), Random.FRandRange(-400.0, 400.0), CapsuleHalfHeight);
+            Trajectory.Sway = FVector(Random.FRandRange(-600.0, 600.0), Random.FRandRange(-600.0, 600.0), 0.0);
+            Trajectory.Radius = Random.FRandRange(0.0, 120.0);
+            Trajectory.AngularSpeed = Random.FRandRange(0.5, 2.5);
+            Trajectory.Phase = Random.FRandRange(0.0, UE_DOUBLE_TWO_PI);
+        }
+        return Trajectories;
+    }
+
+    int32 GetDamageOrigins(const FVector& PointA, const FVector& PointB, const FVector& StringNormal, const double PeakTime, FVector* OutOrigins)
+    {
+        const FVector Displacement{StringNormal * (Amplitude * FMath::Cos(PeakTime * UE_DOUBLE_TWO_PI))};
+        const int32 NumPeaks{StringPeakKernels::GetKernel(Harmonic)(PointA, PointB - PointA, Displacement, OutOrigins)};
+        for (int32 Peak = 0; Peak < NumPeaks; ++Peak)
+        {
+            OutOrigins[Peak] += FVector::ZAxisVector * StringPeakDamage::DamageHeight;
+        }
+        return NumPeaks;
+    }
+
+    uint64 MakeHitKey(const int64 PeakIndex, const int32 PeakNumber, const int32 TargetIndex)
+    {
+        return static_cast<uint64>(PeakIndex) << 32 | static_cast<uint64>(PeakNumber) << 16 | static_cast<uint64>(TargetIndex);
+    }
+
+    // Hits with the exact span and target locations at every peak, plus the ones too close to the edge to compare
+    void EvaluateExactHits(const TArray<FTrajectory>& Trajectories, TSet<uint64>& OutHits, TSet<uint64>& OutAmbiguous)
+    {
+        FVector Origins[StringPeakKernels::MaxPeaks];
+
+        const int64 NumPeaks{FMath::FloorToInt64(Duration / (Period * 0.5))};
+        for (int64 PeakIndex = 1; PeakIndex <= NumPeaks; ++PeakIndex)
+        {
+            const double Time{static_cast<double>(PeakIndex) * Period * 0.5};
+            const double PeakTime{PeakIndex % 2 == 0 ? StringPeakDamage::PeakTime1 : StringPeakDamage::PeakTime2};
+            const StringPeakDamage::FSpanSample Span{GetSpan(Time)};
+            const FVector StringNormal{FVector::CrossProduct(Span.PointB - Span.PointA, FVector::ZAxisVector).GetSafeNormal()};
+            const int32 NumOrigins{GetDamageOrigins(Span.PointA, Span.PointB, StringNormal, PeakTime, Origins)};
+
+            for (int32 TargetIndex = 0; TargetIndex < Trajectories.Num(); ++TargetIndex)
+            {
+                const FVector Center{Trajectories[TargetIndex].Evaluate(Time)};
+                for (int32 PeakNumber = 0; PeakNumber < NumOrigins; ++PeakNumber)
+                {
+                    const FVector ClosestPoint{FMath::ClosestPointOnSegment(Origins[PeakNumber], Center - CapsuleHalfAxis, Center + CapsuleHalfAxis)};
+                    const double DistanceToEdge{FVector::Distance(Origins[PeakNumber], ClosestPoint) - (DamageRadius + CapsuleRadius)};
+
+                    if (FMath::Abs(DistanceToEdge) < AmbiguousBand)
+                    {
+                        OutAmbiguous.Add(MakeHitKey(PeakIndex, PeakNumber, TargetIndex));
+                    }
+                    else if (DistanceToEdge < 0.0)
+                    {
+                        OutHits.Add(MakeHitKey(PeakIndex, PeakNumber, TargetIndex));
+                    }
+                }
+            }
+        }
+    }
+
+    // Same steps as the ability: peaks between two ticks, targets interpolated between their locations at both ticks
+    void EvaluateTickedHits(const TArray<FTrajectory>& Trajectories, const double TickRate, TSet<uint64>& OutHits, TArray<int64>& OutPeakIndices)
+    {
+        FVector Origins[StringPeakKernels::MaxPeaks];
+        StringPeakDamage::FPeakEvents PeakEvents;
+
+        StringPeakDamage::FSpanSample PreviousSpan{GetSpan(0.0)};
+        TArray<FVector> PreviousLocations;
+        for (const FTrajectory& Trajectory : Trajectories)
+        {
+            PreviousLocations.Add(Trajectory.Evaluate(0.0));
+        }
+
+        TArray<FVector> Locations;
+        const int32 NumTicks{FMath::RoundToInt32(Duration * TickRate)};
+        for (int32 Tick = 1; Tick <= NumTicks; ++Tick)
+        {
+            const double Time{static_cast<double>(Tick) / TickRate};
+            const StringPeakDamage::FSpanSample Span{GetSpan(Time)};
+
+            Locations.Reset();
+            for (const FTrajectory& Trajectory : Trajectories)
+            {
+                Locations.Add(Trajectory.Evaluate(Time));
+            }
+
+            StringPeakDamage::FindPeakEvents(Period, PreviousSpan, Span, PeakEvents);
+            for (const StringPeakDamage::FPeakEvent& Event : PeakEvents)
+            {
+                OutPeakIndices.Add(Event.PeakIndex);
+                const int32 NumOrigins{GetDamageOrigins(Event.PointA, Event.PointB, Event.StringNormal, Event.PeakTime, Origins)};
+
+                for (int32 TargetIndex = 0; TargetIndex < Trajectories.Num(); ++TargetIndex)
+                {
+                    const FVector Center{StringPeakDamage::GetLocationAtPeak(Event, Time, Locations[TargetIndex], &PreviousLocations[TargetIndex], FVector::ZeroVector)};
+                    for (int32 PeakNumber = 0; PeakNumber < NumOrigins; ++PeakNumber)
+                    {
+                        if (StringPeakDamage::IsCapsuleWithinRadius(Center, CapsuleHalfAxis, CapsuleRadius, Origins[PeakNumber], DamageRadius))
+                        {
+                            OutHits.Add(MakeHitKey(Event.PeakIndex, PeakNumber, TargetIndex));
+                        }
+                    }
+                }
+            }
+
+            PreviousSpan = Span;
+            Swap(PreviousLocations, Locations);
+        }
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStringPeakDamageTickRateTest, "Archons.String.PeakDamage.TickRateIndependent",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FStringPeakDamageTickRateTest::RunTest(const FString& Parameters)
+{
+    using namespace StringPeakDamageTest;
+
+    const TArray<FTrajectory> Trajectories{MakeTrajectories()};
+
+    TSet<uint64> ExactHits;
+    TSet<uint64> Ambiguous;
+    EvaluateExactHits(Trajectories, ExactHits, Ambiguous);
+
+    TestTrue(TEXT("Some targets are hit"), ExactHits.Num() > 0);
+    TestTrue(TEXT("Few targets are on the edge of the damage radius"), Ambiguous.Num() * 10 < ExactHits.Num());
+
+    TArray<int64> ExpectedPeakIndices;
+    for (int64 PeakIndex = 1; PeakIndex <= FMath::FloorToInt64(Duration / (Period * 0.5)); ++PeakIndex)
+    {
+        ExpectedPeakIndices.Add(PeakIndex);
+    }
+
+    for (const double TickRate : {10.0, 20.0, 60.0})
+    {
+        TSet<uint64> Hits;
+        TArray<int64> PeakIndices;
+        EvaluateTickedHits(Trajectories, TickRate, Hits, PeakIndices);
+
+        TestTrue(FString::Printf(TEXT("Every peak fires once at %g Hz"), TickRate), PeakIndices == ExpectedPeakIndices);
+
+        const TSet<uint64> ComparedHits{Hits.Difference(Ambiguous)};
+        const int32 Missed{ExactHits.Difference(ComparedHits).Num()};
+        const int32 Extra{ComparedHits.Difference(ExactHits).Num()};
+        if (Missed > 0 || Extra > 0)
+        {
+            AddError(FString::Printf(TEXT("Hits at %g Hz differ from the exact ones: %i missed, %i extra out of %i"), TickRate, Missed, Extra, ExactHits.Num()));
+        }
+    }
+
+    return true;
+}
+
+#endif
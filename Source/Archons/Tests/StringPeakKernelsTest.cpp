@@ -0,0 +1,58 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "Archons/Abilities/StringPeakKernels.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStringPeakKernelsTest, "Archons.String.PeakKernels.MatchClosedForm",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FStringPeakKernelsTest::RunTest(const FString& Parameters)
+{
+    constexpr int32 NumSpans = 10000;
+    constexpr double Tolerance = 0.0001;
+
+    TestTrue(TEXT("No kernel below the lowest harmonic"), StringPeakKernels::GetKernel(StringPeakKernels::MinHarmonic - 1) == nullptr);
+    TestTrue(TEXT("No kernel above the highest harmonic"), StringPeakKernels::GetKernel(StringPeakKernels::MaxHarmonic + 1) == nullptr);
+
+    FVector ReferencePositions[StringPeakKernels::MaxPeaks];
+    FVector KernelPositions[StringPeakKernels::MaxPeaks];
+
+    for (int32 HarmonicMode = StringPeakKernels::MinHarmonic; HarmonicMode <= StringPeakKernels::MaxHarmonic; ++HarmonicMode)
+    {
+        const StringPeakKernels::FKernel Kernel{StringPeakKernels::GetKernel(HarmonicMode)};
+        if (!TestTrue(*FString::Printf(TEXT("Kernel of harmonic %i"), HarmonicMode), Kernel != nullptr)) { continue; }
+
+        FRandomStream Random(1234);
+        double MaxError{0.0};
+        for (int32 Index = 0; Index < NumSpans; ++Index)
+        {
+            const FVector PointA{Random.FRandRange(-5000.0, 5000.0), Random.FRandRange(-5000.0, 5000.0), Random.FRandRange(0.0, 200.0)};
+            const FVector PointB{PointA + Random.GetUnitVector().GetSafeNormal2D() * Random.FRandRange(100.0, 2000.0)};
+            const FVector StringNormal{FVector::CrossProduct(PointB - PointA, FVector::ZAxisVector).GetSafeNormal()};
+            const double Amplitude{Random.FRandRange(75.0, 200.0)};
+            const double PeakTime{Index % 2 == 0 ? 1.0 : 0.5};
+
+            const FVector Displacement{StringNormal * (Amplitude * FMath::Cos(PeakTime * UE_DOUBLE_TWO_PI))};
+            const int32 NumReference{StringPeakKernels::EvaluateClosedForm(PointA, PointB, StringNormal, Amplitude, PeakTime, HarmonicMode, ReferencePositions)};
+            const int32 NumKernel{Kernel(PointA, PointB - PointA, Displacement, KernelPositions)};
+
+            if (!TestEqual(*FString::Printf(TEXT("Peaks of harmonic %i"), HarmonicMode), NumKernel, NumReference)) { break; }
+
+            for (int32 Peak = 0; Peak < NumKernel; ++Peak)
+            {
+                MaxError = FMath::Max(MaxError, FVector::Distance(ReferencePositions[Peak], KernelPositions[Peak]));
+            }
+        }
+
+        if (MaxError > Tolerance)
+        {
+            AddError(FString::Printf(TEXT("Harmonic %i: kernel is up to %g cm away from the closed form, tolerance %g cm"), HarmonicMode, MaxError, Tolerance));
+        }
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,105 @@
+﻿// Copyright Sergei Shavrin 2024. All Rights Reserved.
+
+#include "Archons/Abilities/StringWaveSolver.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStringWaveSolverCrestTest, "Archons.String.Solver.CrestsAtAnyNodeCount",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FStringWaveSolverCrestTest::RunTest(const FString& Parameters)
+{
+    constexpr float TimeStep = 1.0f / 480.0f;
+    constexpr float FrameTime = 1.0f / 60.0f;
+    constexpr int32 NumFrames = 126;
+    constexpr int32 Harmonic = 2;
+
+    // Harmonic 2 at a wave speed of one string length per second swings once per second, cresting every half second at both of its peaks
+    constexpr float WaveSpeed = 1.0f;
+    constexpr float HalfPeriod = 0.5f;
+    constexpr float TimeTolerance = 2.0f * TimeStep;
+
+    // Past 481 nodes a single step of 1/480 s would break the stability limit, the wave must still keep its speed
+    for (const int32 NumNodes : {64, 256, 481, 1024, 2048})
+    {
+        FStringWaveSolver Solver;
+        Solver.Initialize(NumNodes, TimeStep);
+        Solver.SetWaveSpeed(WaveSpeed);
+        Solver.SetCrestThreshold(0.25f);
+        Solver.Pluck(Harmonic, 1.0f);
+
+        TArray<float> CrestTimes;
+        for (int32 Frame = 1; Frame <= NumFrames; ++Frame)
+        {
+            Solver.Advance(FrameTime);
+            for (const FStringWaveCrest& Crest : Solver.GetCrests())
+            {
+                CrestTimes.Add(static_cast<float>(Frame) * FrameTime - Crest.Age);
+
+                const float ExpectedPosition{Crest.Peak.Position < 0.5f ? 0.25f : 0.75f};
+                TestNearlyEqual(*FString::Printf(TEXT("%i nodes: crest position"), NumNodes), Crest.Peak.Position, ExpectedPosition, 1.0f / static_cast<float>(NumNodes - 1));
+            }
+        }
+
+        const int32 NumCrests{FMath::FloorToInt32(static_cast<float>(NumFrames) * FrameTime / HalfPeriod) * Harmonic};
+        if (!TestEqual(*FString::Printf(TEXT("%i nodes: number of crests"), NumNodes), CrestTimes.Num(), NumCrests)) { continue; }
+
+        for (int32 Index = 0; Index < CrestTimes.Num(); ++Index)
+        {
+            const float ExpectedTime{static_cast<float>(Index / Harmonic + 1) * HalfPeriod};
+            TestNearlyEqual(*FString::Printf(TEXT("%i nodes: crest %i time"), NumNodes, Index), CrestTimes[Index], ExpectedTime, TimeTolerance);
+        }
+    }
+
+    // Below the threshold nothing crests, however the shape looks
+    FStringWaveSolver Solver;
+    Solver.Initialize(256, TimeStep);
+    Solver.SetWaveSpeed(WaveSpeed);
+    Solver.SetCrestThreshold(0.25f);
+    Solver.Pluck(Harmonic, 0.2f);
+    Solver.Pluck(5, 0.04f);
+
+    int32 NumCrests{0};
+    for (int32 Frame = 1; Frame <= NumFrames; ++Frame)
+    {
+        Solver.Advance(FrameTime);
+        NumCrests += Solver.GetCrests().Num();
+    }
+    TestEqual(TEXT("Crests of a shape below the threshold"), NumCrests, 0);
+
+    // At a Courant number of exactly 1 the scheme is exact in floats, so the middle of 5 nodes swings through 1, 0.41, -0.41, -1, -1, ...
+    // and every crest lands on two equal samples. Each must still be found once, at the first of them.
+    constexpr float PlateauTimeStep = 0.125f;
+    FStringWaveSolver PlateauSolver;
+    PlateauSolver.Initialize(5, PlateauTimeStep);
+    PlateauSolver.SetWaveSpeed(2.0f);
+    PlateauSolver.SetCrestThreshold(0.25f);
+    PlateauSolver.Pluck(1, 1.0f);
+
+    TArray<float> PlateauCrestTimes;
+    for (int32 Frame = 1; Frame <= 16; ++Frame)
+    {
+        PlateauSolver.Advance(PlateauTimeStep);
+        for (const FStringWaveCrest& Crest : PlateauSolver.GetCrests())
+        {
+            PlateauCrestTimes.Add(static_cast<float>(Frame) * PlateauTimeStep - Crest.Age);
+            TestNearlyEqual(TEXT("Plateau crest position"), Crest.Peak.Position, 0.5f);
+        }
+    }
+
+    if (TestEqual(TEXT("Number of plateau crests"), PlateauCrestTimes.Num(), 4))
+    {
+        for (int32 Index = 0; Index < PlateauCrestTimes.Num(); ++Index)
+        {
+            // Harmonic 1 at this speed also crests every half second. The pluck puts the first crest between the two samples around time 0,
+            // so every later one falls half a step before the half second and is found at the sample before it.
+            const float ExpectedTime{static_cast<float>(Index + 1) * HalfPeriod - PlateauTimeStep};
+            TestNearlyEqual(*FString::Printf(TEXT("Plateau crest %i time"), Index), PlateauCrestTimes[Index], ExpectedTime);
+        }
+    }
+
+    return true;
+}
+
+#endif